@@ -0,0 +1,201 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+//! Wait-free single-producer, single-consumer ring buffer of audio frames.
+/*!
+  One thread writes and one other thread reads, neither of them ever
+  blocks or takes a lock, so both sides may run in an audio callback.
+  A frame is channels() consecutive samples of type T and every count
+  of the interface is in frames.  The capacity is rounded up to a power
+  of two frames.
+
+  Frames are exchanged either by copying with write() and read(), or in
+  place through views of at most two contiguous spans: the producer
+  fills writeView() and publishes it with commitWrite(), the consumer
+  processes readView() and releases it with commitRead().
+*/
+template<class T>
+class AudioRingBuffer
+{
+    static_assert(std::is_trivially_copyable<T>::value, "AudioRingBuffer holds plain samples only");
+
+public:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    struct Span
+    {
+        T *data = nullptr;
+        size_t frames = 0;
+    };
+
+    //! Contiguous part of a view, followed by the part wrapped around to the start of the storage.
+    struct View
+    {
+        Span first;
+        Span second;
+        size_t frames() const { return first.frames + second.frames; }
+    };
+
+    AudioRingBuffer() = default;
+    explicit AudioRingBuffer(size_t frames, unsigned int channels = 1) { resize(frames, channels); }
+    AudioRingBuffer(const AudioRingBuffer &) = delete;
+    AudioRingBuffer &operator=(const AudioRingBuffer &) = delete;
+
+    //! Allocates room for at least the given number of frames and empties the ring.
+    /*!
+      The storage is zeroed here, so its pages are backed before the
+      audio thread touches them.  Neither side may use the ring meanwhile.
+    */
+    void resize(size_t frames, unsigned int channels = 1)
+    {
+        size_t capacity = 0;
+        if (frames > 0 && channels > 0) {
+            capacity = 1;
+            while (capacity < frames)
+                capacity <<= 1;
+        }
+        mData = capacity ? std::make_unique<T[]>(capacity * channels) : nullptr;
+        mCapacity = capacity;
+        mChannels = channels;
+        reset();
+    }
+
+    //! Drops all frames. Neither side may use the ring meanwhile.
+    void reset()
+    {
+        mWriteIndex.store(0, std::memory_order_relaxed);
+        mReadIndex.store(0, std::memory_order_relaxed);
+        mReadIndexCache = 0;
+        mWriteIndexCache = 0;
+    }
+
+    size_t capacity() const { return mCapacity; }
+    unsigned int channels() const { return mChannels; }
+
+    //! Frames ready to be read, exact on the consumer side.
+    size_t readAvailable() const
+    {
+        size_t read = mReadIndex.load(std::memory_order_relaxed);
+        return mWriteIndex.load(std::memory_order_acquire) - read;
+    }
+
+    //! Room for frames to be written, exact on the producer side.
+    size_t writeAvailable() const
+    {
+        size_t write = mWriteIndex.load(std::memory_order_relaxed);
+        return mCapacity - (write - mReadIndex.load(std::memory_order_acquire));
+    }
+
+    // Producer side.
+
+    //! Returns up to the given number of free frames, to be published with commitWrite().
+    View writeView(size_t frames = SIZE_MAX)
+    {
+        size_t write = mWriteIndex.load(std::memory_order_relaxed);
+        // The consumer index is only reloaded when the cached one shows too little room.
+        if (mCapacity - (write - mReadIndexCache) < frames)
+            mReadIndexCache = mReadIndex.load(std::memory_order_acquire);
+        return view(write, std::min(frames, mCapacity - (write - mReadIndexCache)));
+    }
+
+    //! Publishes frames filled through writeView().
+    void commitWrite(size_t frames)
+    {
+        mWriteIndex.store(mWriteIndex.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+    }
+
+    //! Copies all frames in or returns false without writing anything.
+    bool write(const T *frames, size_t count)
+    {
+        View free = writeView(count);
+        if (free.frames() < count)
+            return false;
+        size_t firstSamples = free.first.frames * mChannels;
+        std::memcpy(free.first.data, frames, firstSamples * sizeof(T));
+        std::memcpy(free.second.data, frames + firstSamples, free.second.frames * mChannels * sizeof(T));
+        commitWrite(count);
+        return true;
+    }
+
+    //! Writes zeroed frames or returns false without writing anything.
+    bool writeSilence(size_t count)
+    {
+        View free = writeView(count);
+        if (free.frames() < count)
+            return false;
+        std::memset(free.first.data, 0, free.first.frames * mChannels * sizeof(T));
+        std::memset(free.second.data, 0, free.second.frames * mChannels * sizeof(T));
+        commitWrite(count);
+        return true;
+    }
+
+    // Consumer side.
+
+    //! Returns up to the given number of written frames, to be released with commitRead().
+    View readView(size_t frames = SIZE_MAX)
+    {
+        size_t read = mReadIndex.load(std::memory_order_relaxed);
+        if (mWriteIndexCache - read < frames)
+            mWriteIndexCache = mWriteIndex.load(std::memory_order_acquire);
+        return view(read, std::min(frames, mWriteIndexCache - read));
+    }
+
+    //! Releases frames obtained through readView() to the producer.
+    void commitRead(size_t frames)
+    {
+        mReadIndex.store(mReadIndex.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+    }
+
+    //! Copies all frames out or returns false without reading anything.
+    bool read(T *frames, size_t count)
+    {
+        View ready = readView(count);
+        if (ready.frames() < count)
+            return false;
+        size_t firstSamples = ready.first.frames * mChannels;
+        std::memcpy(frames, ready.first.data, firstSamples * sizeof(T));
+        std::memcpy(frames + firstSamples, ready.second.data, ready.second.frames * mChannels * sizeof(T));
+        commitRead(count);
+        return true;
+    }
+
+    //! Drops frames or returns false without dropping anything.
+    bool skip(size_t count)
+    {
+        if (readView(count).frames() < count)
+            return false;
+        commitRead(count);
+        return true;
+    }
+
+private:
+    View view(size_t index, size_t frames) const
+    {
+        View result;
+        if (mCapacity == 0)
+            return result;
+        size_t offset = index & (mCapacity - 1);
+        result.first.data = mData.get() + offset * mChannels;
+        result.first.frames = std::min(frames, mCapacity - offset);
+        result.second.data = mData.get();
+        result.second.frames = frames - result.first.frames;
+        return result;
+    }
+
+    // The indices count frames since the last reset and are only ever
+    // reduced modulo the capacity. Each side keeps its own index and a
+    // cached copy of the other one on a separate cache line.
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> mWriteIndex{0};
+    size_t mReadIndexCache = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> mReadIndex{0};
+    size_t mWriteIndexCache = 0;
+    alignas(CACHE_LINE_SIZE) std::unique_ptr<T[]> mData;
+    size_t mCapacity = 0;
+    unsigned int mChannels = 1;
+};
@@ -0,0 +1,180 @@
+#include "BlockingStream.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr unsigned int DEFAULT_RING_PERIODS = 4;
+} // namespace
+
+std::unique_ptr<BlockingStream> BlockingStream::open(RtApiStreamClassFactory &factory,
+                                                     CreateStreamParams params,
+                                                     unsigned long ringFrames)
+{
+    // The rings hold interleaved frames only.
+    RtAudio::StreamOptions options{};
+    if (params.options)
+        options = *params.options;
+    options.flags &= ~RTAUDIO_NONINTERLEAVED;
+    params.options = &options;
+
+    std::unique_ptr<BlockingStream> blocking(new BlockingStream());
+    params.callback = &BlockingStream::streamCallback;
+    params.userData = blocking.get();
+    blocking->mStream = factory.createStream(params);
+    if (!blocking->mStream)
+        return nullptr;
+
+    // The stream is stopped, so the rings can be set up before the first callback.
+    BlockingStream *raw = blocking.get();
+    raw->mBufferSize = raw->mStream->getBufferSize();
+    size_t depth = ringFrames ? ringFrames : size_t(raw->mBufferSize) * DEFAULT_RING_PERIODS;
+    depth = std::max<size_t>(depth, size_t(raw->mBufferSize) * 2);
+    unsigned int sampleBytes = RtApi::formatBytes(params.format);
+    if (params.mode == RtApi::OUTPUT || params.mode == RtApi::DUPLEX) {
+        raw->mOutput.frameBytes = params.channelsOutput * sampleBytes;
+        raw->mOutput.ring.resize(depth, raw->mOutput.frameBytes);
+    }
+    if (params.mode == RtApi::INPUT || params.mode == RtApi::DUPLEX) {
+        raw->mInput.frameBytes = params.channelsInput * sampleBytes;
+        raw->mInput.ring.resize(depth, raw->mInput.frameBytes);
+    }
+    raw->mStream->setStreamFinishedCallback([raw](RtAudioErrorType) { raw->wakeAll(); });
+    return blocking;
+}
+
+BlockingStream::~BlockingStream()
+{
+    mStream.reset();
+}
+
+RtAudioErrorType BlockingStream::start()
+{
+    return mStream->startStream();
+}
+
+RtAudioErrorType BlockingStream::stop()
+{
+    RtAudioErrorType result = mStream->stopStream();
+    wakeAll();
+    return result;
+}
+
+unsigned long BlockingStream::write(const void *buffer, unsigned long frames)
+{
+    if (mOutput.frameBytes == 0)
+        return 0;
+    return transfer(mOutput, static_cast<char *>(const_cast<void *>(buffer)), frames, true);
+}
+
+unsigned long BlockingStream::read(void *buffer, unsigned long frames)
+{
+    if (mInput.frameBytes == 0)
+        return 0;
+    return transfer(mInput, static_cast<char *>(buffer), frames, false);
+}
+
+unsigned long BlockingStream::writeAvailable() const
+{
+    return mOutput.frameBytes ? (unsigned long) mOutput.ring.writeAvailable() : 0;
+}
+
+unsigned long BlockingStream::readAvailable() const
+{
+    return mInput.frameBytes ? (unsigned long) mInput.ring.readAvailable() : 0;
+}
+
+unsigned long BlockingStream::transfer(Direction &direction, char *buffer, unsigned long frames, bool output)
+{
+    AudioRingBuffer<char> &ring = direction.ring;
+    unsigned long done = 0;
+    while (true) {
+        AudioRingBuffer<char>::View view = output ? ring.writeView(frames - done) : ring.readView(frames - done);
+        for (const AudioRingBuffer<char>::Span &span : {view.first, view.second}) {
+            size_t bytes = span.frames * direction.frameBytes;
+            if (output)
+                memcpy(span.data, buffer + size_t(done) * direction.frameBytes, bytes);
+            else
+                memcpy(buffer + size_t(done) * direction.frameBytes, span.data, bytes);
+            done += (unsigned long) span.frames;
+        }
+        if (output)
+            ring.commitWrite(view.frames());
+        else
+            ring.commitRead(view.frames());
+        if (done == frames || mStream->isStreamRunning() == false)
+            return done;
+
+        // Sleeps until a period, or the rest if it is shorter, can be
+        // exchanged. The signal is read before anything is checked, so a
+        // wake-up from the callback or stop() in between is not lost.
+        size_t wanted = std::min<size_t>(frames - done, mBufferSize);
+        int signal = direction.signal.load(std::memory_order_acquire);
+        direction.wanted.store(wanted, std::memory_order_relaxed);
+        // Pairs with the fence in notifyIfWanted(): either the callback
+        // sees the wanted frames or the ring state checked here includes
+        // its last period.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        size_t available = output ? ring.writeAvailable() : ring.readAvailable();
+        if (available < wanted && mStream->isStreamRunning())
+            direction.signal.wait(signal, std::memory_order_acquire);
+        direction.wanted.store(0, std::memory_order_relaxed);
+    }
+}
+
+int BlockingStream::streamCallback(void *outputBuffer,
+                                   const void *inputBuffer,
+                                   unsigned int nFrames,
+                                   double /*streamTime*/,
+                                   RtAudioStreamStatus /*status*/,
+                                   void *userData)
+{
+    BlockingStream *blocking = static_cast<BlockingStream *>(userData);
+    if (inputBuffer && blocking->mInput.frameBytes)
+        blocking->processInput(static_cast<const char *>(inputBuffer), nFrames);
+    if (outputBuffer && blocking->mOutput.frameBytes)
+        blocking->processOutput(static_cast<char *>(outputBuffer), nFrames);
+    return 0;
+}
+
+void BlockingStream::processOutput(char *buffer, unsigned int frames)
+{
+    AudioRingBuffer<char>::View ready = mOutput.ring.readView(frames);
+    size_t done = 0;
+    for (const AudioRingBuffer<char>::Span &span : {ready.first, ready.second}) {
+        memcpy(buffer + done * mOutput.frameBytes, span.data, span.frames * mOutput.frameBytes);
+        done += span.frames;
+    }
+    if (done < frames) {
+        memset(buffer + done * mOutput.frameBytes, 0, (frames - done) * mOutput.frameBytes);
+        mOutputUnderflows.fetch_add(1, std::memory_order_relaxed);
+    }
+    mOutput.ring.commitRead(done);
+    notifyIfWanted(mOutput, mOutput.ring.writeAvailable());
+}
+
+void BlockingStream::processInput(const char *buffer, unsigned int frames)
+{
+    if (mInput.ring.write(buffer, frames) == false)
+        mInputOverflows.fetch_add(1, std::memory_order_relaxed);
+    notifyIfWanted(mInput, mInput.ring.readAvailable());
+}
+
+void BlockingStream::notifyIfWanted(Direction &direction, size_t available)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    size_t wanted = direction.wanted.load(std::memory_order_relaxed);
+    // The caller clears wanted itself once awake, the callback never
+    // writes it, so a newer request can not be lost.
+    if (wanted == 0 || available < wanted)
+        return;
+    direction.signal.fetch_add(1, std::memory_order_release);
+    direction.signal.notify_one();
+}
+
+void BlockingStream::wakeAll()
+{
+    for (Direction *direction : {&mOutput, &mInput}) {
+        direction->signal.fetch_add(1, std::memory_order_release);
+        direction->signal.notify_all();
+    }
+}
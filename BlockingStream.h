@@ -0,0 +1,92 @@
+#pragma once
+#include "AudioRingBuffer.h"
+#include "RtAudio.h"
+#include <atomic>
+#include <memory>
+
+//! Blocking read and write access to a callback driven stream.
+/*!
+  The stream callback is owned by the adapter and only moves frames
+  between the device buffers and one AudioRingBuffer per direction.
+  write() and read() copy from and to these rings and block while there
+  is no room or no data.  The callback never takes a lock, it wakes a
+  blocked caller through a futex based atomic wait once a whole period
+  can be exchanged, and only if a caller is actually waiting.
+
+  Frames are interleaved in the format of the stream.  Missing output
+  is played as silence and counted as underflow, input that does not
+  fit into the ring is dropped and counted as overflow.
+*/
+class RTAUDIO_DLL_PUBLIC BlockingStream
+{
+public:
+    //! Opens a stream through the factory, the callback and userData of params are replaced.
+    /*!
+      \c ringFrames is the depth of each ring, rounded up to a power of
+      two.  0 selects four periods.  Returns nullptr if the factory fails,
+      the error is reported through the factory.
+    */
+    static std::unique_ptr<BlockingStream> open(RtApiStreamClassFactory &factory,
+                                                CreateStreamParams params,
+                                                unsigned long ringFrames = 0);
+    ~BlockingStream();
+    BlockingStream(const BlockingStream &) = delete;
+    BlockingStream &operator=(const BlockingStream &) = delete;
+
+    RtAudioErrorType start();
+    //! Stops the stream and returns from all blocked write() and read() calls.
+    RtAudioErrorType stop();
+
+    //! Blocks until all frames were queued for playback.
+    /*!
+      Frames are queued without blocking as long as the ring has room,
+      so the output can be prefilled before start().  Returns fewer
+      frames than requested if the stream is not running.
+    */
+    unsigned long write(const void *buffer, unsigned long frames);
+    //! Blocks until the requested frames were recorded. Returns fewer frames if the stream is not running.
+    unsigned long read(void *buffer, unsigned long frames);
+
+    //! Frames write() accepts without blocking.
+    unsigned long writeAvailable() const;
+    //! Frames read() returns without blocking.
+    unsigned long readAvailable() const;
+
+    unsigned long long getOutputUnderflows() const { return mOutputUnderflows.load(std::memory_order_relaxed); }
+    unsigned long long getInputOverflows() const { return mInputOverflows.load(std::memory_order_relaxed); }
+
+    RtApiStreamClass &getStream() { return *mStream; }
+
+private:
+    BlockingStream() = default;
+
+    static int streamCallback(void *outputBuffer,
+                              const void *inputBuffer,
+                              unsigned int nFrames,
+                              double streamTime,
+                              RtAudioStreamStatus status,
+                              void *userData);
+    void processOutput(char *buffer, unsigned int frames);
+    void processInput(const char *buffer, unsigned int frames);
+    void wakeAll();
+
+    // A blocked caller publishes the frames it waits for in its wanted
+    // counter and sleeps on its signal. The callback bumps the signal
+    // only when the counter is set and satisfied.
+    struct Direction
+    {
+        AudioRingBuffer<char> ring; // One sample per byte, one stream frame per ring frame.
+        unsigned int frameBytes = 0;
+        alignas(AudioRingBuffer<char>::CACHE_LINE_SIZE) std::atomic<size_t> wanted{0};
+        std::atomic<int> signal{0};
+    };
+    unsigned long transfer(Direction &direction, char *buffer, unsigned long frames, bool output);
+    static void notifyIfWanted(Direction &direction, size_t available);
+
+    std::shared_ptr<RtApiStreamClass> mStream;
+    unsigned int mBufferSize = 0;
+    Direction mOutput;
+    Direction mInput;
+    std::atomic<unsigned long long> mOutputUnderflows{0};
+    std::atomic<unsigned long long> mInputOverflows{0};
+};
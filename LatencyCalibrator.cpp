@@ -0,0 +1,159 @@
+#include "LatencyCalibrator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace {
+struct CalibrationState
+{
+    double load = 0.0;
+    unsigned int sampleRate = 0;
+    unsigned int frameBytes = 0;
+    unsigned long long callbacks = 0;
+    unsigned long long deadlineMisses = 0;
+    unsigned long long framesProcessed = 0;
+    double maxLoad = 0.0;
+    std::chrono::steady_clock::time_point anchor{};
+    unsigned long long anchorFrames = 0;
+};
+
+int calibrationCallback(void *outputBuffer,
+                        const void * /*inputBuffer*/,
+                        unsigned int nFrames,
+                        double /*streamTime*/,
+                        RtAudioStreamStatus status,
+                        void *userData)
+{
+    using namespace std::chrono;
+    auto *state = static_cast<CalibrationState *>(userData);
+    auto entry = steady_clock::now();
+    auto period = duration_cast<steady_clock::duration>(duration<double>(double(nFrames) / state->sampleRate));
+
+    // The ideal entry time follows the frames processed so far. Early
+    // entries (for example while the device buffer is filled) move the
+    // anchor, so only lateness counts. A miss or an xrun also moves it, so
+    // one stall is counted once and not again for every later callback.
+    if (state->callbacks == 0) {
+        state->anchor = entry;
+        state->anchorFrames = 0;
+    } else {
+        auto ideal = state->anchor
+                     + duration_cast<steady_clock::duration>(duration<double>(
+                         double(state->framesProcessed - state->anchorFrames) / state->sampleRate));
+        bool missed = status & (RTAUDIO_INPUT_OVERFLOW | RTAUDIO_OUTPUT_UNDERFLOW);
+        if (entry >= ideal && entry - ideal > period)
+            missed = true;
+        if (missed)
+            state->deadlineMisses++;
+        if (missed || entry < ideal) {
+            state->anchor = entry;
+            state->anchorFrames = state->framesProcessed;
+        }
+    }
+
+    auto busyUntil = entry + duration_cast<steady_clock::duration>(period * state->load);
+    while (steady_clock::now() < busyUntil) {
+    }
+    if (outputBuffer)
+        memset(outputBuffer, 0, size_t(nFrames) * state->frameBytes);
+
+    auto spent = steady_clock::now() - entry;
+    state->maxLoad = std::max(state->maxLoad, duration<double>(spent).count() / duration<double>(period).count());
+    state->callbacks++;
+    state->framesProcessed += nFrames;
+    return 0;
+}
+} // namespace
+
+LatencyCalibrator::LatencyCalibrator(Params params)
+    : mParams(std::move(params))
+{}
+
+void LatencyCalibrator::setProgressCallback(std::function<void(const Candidate &)> callback)
+{
+    mProgressCallback = callback;
+}
+
+LatencyCalibrator::Result LatencyCalibrator::run()
+{
+    std::vector<std::pair<unsigned int, unsigned int>> configs;
+    for (unsigned int bufferSize : mParams.bufferSizes)
+        for (unsigned int periods : mParams.periodCounts)
+            configs.push_back({bufferSize, periods});
+    std::stable_sort(configs.begin(), configs.end(), [](const auto &a, const auto &b) {
+        return a.first * a.second < b.first * b.second;
+    });
+
+    Result result;
+    for (auto [bufferSize, periods] : configs) {
+        Candidate candidate = runCandidate(bufferSize, periods);
+        result.candidates.push_back(candidate);
+        if (mProgressCallback)
+            mProgressCallback(candidate);
+        if (candidate.isStable()) {
+            result.smallestStable = candidate;
+            result.recommendedBufferSize = candidate.actualBufferSize;
+            result.recommendedPeriods = candidate.periods + mParams.safetyPeriods;
+            break;
+        }
+    }
+    return result;
+}
+
+LatencyCalibrator::Candidate LatencyCalibrator::runCandidate(unsigned int bufferSize, unsigned int periods)
+{
+    Candidate candidate;
+    candidate.bufferSize = bufferSize;
+    candidate.periods = periods;
+
+    auto factory = RtAudio::GetRtAudioStreamFactory(mParams.api);
+    if (!factory)
+        return candidate;
+
+    CalibrationState state;
+    state.sampleRate = mParams.sampleRate;
+    state.load = std::clamp(mParams.dspLoad, 0.0, 1.0);
+    state.frameBytes = mParams.channels * RtApi::formatBytes(mParams.format);
+
+    RtAudio::StreamOptions options{};
+    options.flags = mParams.flags;
+    options.priority = mParams.priority;
+    options.numberOfBuffers = periods;
+
+    CreateStreamParams params{};
+    params.busId = mParams.busId;
+    params.mode = mParams.mode;
+    if (mParams.mode != RtApi::INPUT)
+        params.channelsOutput = mParams.channels;
+    if (mParams.mode != RtApi::OUTPUT)
+        params.channelsInput = mParams.channels;
+    params.sampleRate = mParams.sampleRate;
+    params.format = mParams.format;
+    params.bufferSize = bufferSize;
+    params.callback = calibrationCallback;
+    params.userData = &state;
+    params.options = &options;
+
+    auto stream = factory->createStream(params);
+    if (!stream)
+        return candidate;
+    candidate.opened = true;
+    candidate.actualBufferSize = stream->getBufferSize();
+    if (stream->startStream() != RTAUDIO_NO_ERROR) {
+        candidate.opened = false;
+        return candidate;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(mParams.durationMs);
+    while (stream->isStreamRunning() && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    bool failed = stream->isStreamRunning() == false;
+    stream->stopStream();
+
+    RtAudioXrunStatistics xruns = stream->getXrunStatistics();
+    candidate.xruns = xruns.outputUnderflows + xruns.inputOverflows + (failed ? 1 : 0);
+    candidate.callbacks = state.callbacks;
+    candidate.deadlineMisses = state.deadlineMisses;
+    candidate.maxLoad = state.maxLoad;
+    return candidate;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "RtAudio.h"
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Finds the smallest buffer configuration a device runs without glitches
+// under a given callback load. Every candidate is opened through
+// RtAudio::GetRtAudioStreamFactory(), exactly like a production stream,
+// and runs a callback that busy-waits for the requested share of each
+// period while producing silence.
+class RTAUDIO_DLL_PUBLIC LatencyCalibrator
+{
+public:
+    struct Params
+    {
+        RtAudio::Api api = RtAudio::UNSPECIFIED;
+        std::string busId;
+        RtApi::StreamMode mode = RtApi::OUTPUT;
+        unsigned int channels = 2;
+        unsigned int sampleRate = 48000;
+        RtAudioFormat format = RTAUDIO_FLOAT32;
+        std::vector<unsigned int> bufferSizes = {32, 64, 128, 256, 512, 1024};
+        std::vector<unsigned int> periodCounts = {2, 3, 4};
+        double dspLoad = 0.5;           // Share of each period spent in the callback.
+        unsigned int durationMs = 5000; // Run time per candidate.
+        unsigned int safetyPeriods = 1; // Added to the smallest stable configuration.
+        RtAudioStreamFlags flags = RTAUDIO_SCHEDULE_REALTIME;
+        int priority = 0;
+    };
+
+    struct Candidate
+    {
+        unsigned int bufferSize = 0;       // Requested frames per period.
+        unsigned int actualBufferSize = 0; // Frames per period the device accepted.
+        unsigned int periods = 0;
+        bool opened = false;
+        unsigned long long callbacks = 0;
+        unsigned long long xruns = 0;
+        unsigned long long deadlineMisses = 0; // Callbacks entered more than a period late.
+        double maxLoad = 0.0;                  // Longest callback relative to its period.
+
+        bool isStable() const { return opened && callbacks > 0 && xruns == 0 && deadlineMisses == 0; }
+        unsigned long latencyFrames() const { return (unsigned long) actualBufferSize * periods; }
+    };
+
+    struct Result
+    {
+        std::vector<Candidate> candidates; // In the order they were tried.
+        std::optional<Candidate> smallestStable;
+        unsigned int recommendedBufferSize = 0;
+        unsigned int recommendedPeriods = 0;
+    };
+
+    explicit LatencyCalibrator(Params params);
+
+    // Called after each candidate finished, for progress output.
+    void setProgressCallback(std::function<void(const Candidate &)> callback);
+
+    // Tries the candidates by increasing nominal latency and stops at the
+    // first stable one. Blocks for up to durationMs per candidate.
+    Result run();
+
+private:
+    Candidate runCandidate(unsigned int bufferSize, unsigned int periods);
+
+    Params mParams;
+    std::function<void(const Candidate &)> mProgressCallback = nullptr;
+};
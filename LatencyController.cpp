@@ -0,0 +1,61 @@
+#include "LatencyController.h"
+#include <algorithm>
+
+namespace {
+// Smoothing of the callback load, roughly the last 16 periods.
+constexpr double LOAD_SMOOTHING = 1.0 / 16;
+constexpr double LOAD_GROW = 0.75;
+constexpr double LOAD_SHRINK = 0.5;
+// Seconds without xruns and with low load before shrinking one step.
+constexpr unsigned int STABLE_SECONDS = 10;
+// Seconds between two load triggered grow steps.
+constexpr unsigned int COOLDOWN_SECONDS = 1;
+} // namespace
+
+LatencyController::LatencyController(unsigned int minPeriods,
+                                     unsigned int maxPeriods,
+                                     unsigned int periodsPerSecond)
+    : mMinPeriods(std::max(minPeriods, 1u))
+    , mMaxPeriods(std::max(maxPeriods, mMinPeriods))
+    , mPeriods(mMinPeriods)
+    , mStableLimit(uint64_t(std::max(periodsPerSecond, 1u)) * STABLE_SECONDS)
+    , mCooldownLimit(uint64_t(std::max(periodsPerSecond, 1u)) * COOLDOWN_SECONDS)
+{}
+
+bool LatencyController::onPeriod(uint64_t callbackNs, uint64_t periodNs)
+{
+    if (periodNs == 0)
+        return false;
+    double load = double(callbackNs) / double(periodNs);
+    mLoad += (load - mLoad) * LOAD_SMOOTHING;
+    if (mCooldown > 0)
+        mCooldown--;
+
+    if (mLoad > LOAD_GROW && mCooldown == 0)
+        return grow();
+
+    if (mLoad < LOAD_SHRINK)
+        mStablePeriods++;
+    else
+        mStablePeriods = 0;
+    if (mStablePeriods < mStableLimit || mPeriods == mMinPeriods)
+        return false;
+    mStablePeriods = 0;
+    mPeriods--;
+    return true;
+}
+
+bool LatencyController::onXrun()
+{
+    return grow();
+}
+
+bool LatencyController::grow()
+{
+    mStablePeriods = 0;
+    mCooldown = mCooldownLimit;
+    if (mPeriods == mMaxPeriods)
+        return false;
+    mPeriods++;
+    return true;
+}
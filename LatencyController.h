@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+
+// Decides how many periods of output a stream keeps queued in adaptive
+// latency mode. It starts at the minimum, grows on every xrun and when
+// the callback load gets close to the period, and shrinks one step at a
+// time after a long stretch without trouble. Used from the audio thread
+// only.
+class LatencyController
+{
+public:
+    LatencyController(unsigned int minPeriods, unsigned int maxPeriods, unsigned int periodsPerSecond);
+
+    unsigned int periods() const { return mPeriods; }
+    double load() const { return mLoad; }
+
+    // Called once per period with the time spent in the user callback.
+    // Returns true if periods() changed.
+    bool onPeriod(uint64_t callbackNs, uint64_t periodNs);
+    // Returns true if periods() changed.
+    bool onXrun();
+
+private:
+    bool grow();
+
+    unsigned int mMinPeriods;
+    unsigned int mMaxPeriods;
+    unsigned int mPeriods;
+    uint64_t mStableLimit;
+    uint64_t mCooldownLimit;
+    uint64_t mStablePeriods = 0;
+    uint64_t mCooldown = 0;
+    double mLoad = 0.0;
+};
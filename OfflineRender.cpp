@@ -0,0 +1,299 @@
+#include "OfflineRender.h"
+#include "ThreadSuspendable.h"
+#include "WavFile.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+constexpr unsigned int OFFLINE_DEFAULT_BUFFER_SIZE = 512;
+constexpr float OFFLINE_SIGNAL_AMPLITUDE = 0.5f;
+constexpr double TWO_PI = 6.283185307179586;
+} // namespace
+
+RtApiOfflineStreamFactory::RtApiOfflineStreamFactory(OfflineRenderConfig config)
+    : mConfig(std::move(config))
+{}
+
+std::shared_ptr<RtApiStreamClass> RtApiOfflineStreamFactory::createStream(CreateStreamParams params)
+{
+    return createOfflineStream(std::move(params));
+}
+
+std::shared_ptr<RtApiOfflineStream> RtApiOfflineStreamFactory::createOfflineStream(CreateStreamParams params)
+{
+    bool output = params.mode == RtApi::OUTPUT || params.mode == RtApi::DUPLEX;
+    bool input = params.mode == RtApi::INPUT || params.mode == RtApi::DUPLEX;
+    if (!output && !input) {
+        error(RTAUDIO_INVALID_PARAMETER, "RtApiOfflineStreamFactory::createStream: invalid stream mode.");
+        return {};
+    }
+    if ((output && params.channelsOutput == 0) || (input && params.channelsInput == 0)
+        || params.sampleRate == 0 || RtApi::formatBytes(params.format) == 0) {
+        error(RTAUDIO_INVALID_PARAMETER, "RtApiOfflineStreamFactory::createStream: invalid stream parameters.");
+        return {};
+    }
+    if (params.bufferSize == 0)
+        params.bufferSize = OFFLINE_DEFAULT_BUFFER_SIZE;
+
+    OfflineRenderConfig config = mConfig;
+    RtApi::RtApiStream stream_{};
+    std::unique_ptr<WavFileReader> reader;
+    std::unique_ptr<WavFileWriter> writer;
+
+    if (input && config.inputFile.empty() == false) {
+        reader = std::make_unique<WavFileReader>();
+        if (reader->open(config.inputFile) == false) {
+            errorStream_ << "RtApiOfflineStreamFactory::createStream: " << config.inputFile << ": "
+                         << reader->getErrorText() << ".";
+            error(RTAUDIO_INVALID_DEVICE, errorStream_.str());
+            return {};
+        }
+        const WavFormat &format = reader->format();
+        if (format.sampleRate != params.sampleRate || format.channels < params.channelsInput) {
+            errorStream_ << "RtApiOfflineStreamFactory::createStream: " << config.inputFile << " has "
+                         << format.channels << " channels at " << format.sampleRate << " Hz.";
+            error(RTAUDIO_INVALID_PARAMETER, errorStream_.str());
+            return {};
+        }
+        stream_.deviceFormat[RtApi::INPUT] = format.format;
+        stream_.nDeviceChannels[RtApi::INPUT] = format.channels;
+        if (config.lengthFrames == 0)
+            config.lengthFrames = reader->frames();
+    } else if (input) {
+        stream_.deviceFormat[RtApi::INPUT] = RTAUDIO_FLOAT32;
+        stream_.nDeviceChannels[RtApi::INPUT] = params.channelsInput;
+    }
+    stream_.deviceInterleaved[RtApi::INPUT] = true;
+
+    if (output) {
+        stream_.deviceFormat[RtApi::OUTPUT] = params.format;
+        stream_.nDeviceChannels[RtApi::OUTPUT] = params.channelsOutput;
+        if (config.outputFile.empty() == false) {
+            // WAV has no signed 8 bit samples.
+            if (WavFormat::isSupported(params.format) == false)
+                stream_.deviceFormat[RtApi::OUTPUT] = RTAUDIO_SINT16;
+            writer = std::make_unique<WavFileWriter>();
+            WavFormat format;
+            format.channels = params.channelsOutput;
+            format.sampleRate = params.sampleRate;
+            format.format = stream_.deviceFormat[RtApi::OUTPUT];
+            if (writer->open(config.outputFile, format) == false) {
+                errorStream_ << "RtApiOfflineStreamFactory::createStream: " << config.outputFile << ": "
+                             << writer->getErrorText() << ".";
+                error(RTAUDIO_INVALID_DEVICE, errorStream_.str());
+                return {};
+            }
+        }
+    }
+    stream_.deviceInterleaved[RtApi::OUTPUT] = true;
+
+    stream_.nBuffers = 1;
+    if (setupStreamWithParams(stream_, params) == false) {
+        return {};
+    }
+    if (setupStreamCommon(stream_) == false) {
+        return {};
+    }
+    return std::make_shared<RtApiOfflineStream>(std::move(stream_),
+                                                std::move(config),
+                                                std::move(reader),
+                                                std::move(writer));
+}
+
+RtApiOfflineStream::RtApiOfflineStream(RtApi::RtApiStream stream,
+                                       OfflineRenderConfig config,
+                                       std::unique_ptr<WavFileReader> input,
+                                       std::unique_ptr<WavFileWriter> output)
+    : RtApiStreamClass(std::move(stream))
+    , mConfig(std::move(config))
+    , mInput(std::move(input))
+    , mOutput(std::move(output))
+{
+    if (stream_.mode != RtApi::INPUT && !mOutput && mConfig.lengthFrames > 0)
+        mRenderedOutput.reserve(mConfig.lengthFrames * stream_.nDeviceChannels[RtApi::OUTPUT]
+                                * RtApi::formatBytes(stream_.deviceFormat[RtApi::OUTPUT]));
+    // Not realtime, rendering only competes with the other work of the process.
+    mThread = std::make_unique<ThreadSuspendable>([this]() { return threadMethod(); });
+    if (mThread->isValid() == false)
+        error(RTAUDIO_THREAD_ERROR, "RtApiOfflineStream::error creating render thread!");
+}
+
+RtApiOfflineStream::~RtApiOfflineStream()
+{
+    mThread->stop();
+    if (mOutput)
+        mOutput->close();
+}
+
+RtAudioErrorType RtApiOfflineStream::startStream()
+{
+    if (stream_.state != RtApi::STREAM_STOPPED) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    if (isOutputFinalized()) {
+        return error(RTAUDIO_INVALID_USE, "RtApiOfflineStream::startStream: the output file is already complete.");
+    }
+    stream_.state = RtApi::STREAM_RUNNING;
+    mThread->resume();
+    return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiOfflineStream::stopStream()
+{
+    if (stream_.state != RtApi::STREAM_RUNNING) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    mThread->suspend();
+    stream_.state = RtApi::STREAM_STOPPED;
+    return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiOfflineStream::render()
+{
+    if (stream_.state != RtApi::STREAM_STOPPED) {
+        return error(RTAUDIO_INVALID_USE, "RtApiOfflineStream::render: the stream must be stopped.");
+    }
+    if (isOutputFinalized()) {
+        return error(RTAUDIO_INVALID_USE, "RtApiOfflineStream::render: the output file is already complete.");
+    }
+    stream_.state = RtApi::STREAM_RUNNING;
+    while (stream_.state == RtApi::STREAM_RUNNING && renderPeriod()) {
+    }
+    stream_.state = RtApi::STREAM_STOPPED;
+    RtAudioErrorType result = finishRender();
+    if (result != RTAUDIO_NO_ERROR)
+        return error(result, "RtApiOfflineStream::render: error writing the output file.");
+    return RTAUDIO_NO_ERROR;
+}
+
+bool RtApiOfflineStream::threadMethod()
+{
+    if (renderPeriod())
+        return true;
+    mThread->requestSuspend();
+    stream_.state = RtApi::STREAM_STOPPED;
+    RtAudioErrorType result = finishRender();
+    if (result != RTAUDIO_NO_ERROR)
+        errorThread(result, "RtApiOfflineStream: error writing the output file.");
+    notifyStreamFinished(result);
+    return true;
+}
+
+bool RtApiOfflineStream::renderPeriod()
+{
+    unsigned long long rendered = mRenderedFrames;
+    unsigned int frames = stream_.bufferSize;
+    if (mConfig.lengthFrames > 0) {
+        if (rendered >= mConfig.lengthFrames)
+            return false;
+        frames = (unsigned int) std::min<unsigned long long>(frames, mConfig.lengthFrames - rendered);
+    }
+
+    if (stream_.mode == RtApi::INPUT || stream_.mode == RtApi::DUPLEX)
+        processInput();
+
+    // Derived from the frame count, so hours of rendering do not accumulate rounding errors.
+    stream_.streamTime = double(rendered) / stream_.sampleRate;
+    RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
+    int callbackResult = callback(stream_.userBuffer[RtApi::OUTPUT].get(),
+                                  stream_.userBuffer[RtApi::INPUT].get(),
+                                  stream_.bufferSize,
+                                  stream_.streamTime,
+                                  0,
+                                  stream_.callbackInfo.userData);
+    if (callbackResult == 2)
+        return false;
+
+    if (stream_.mode == RtApi::OUTPUT || stream_.mode == RtApi::DUPLEX) {
+        if (processOutput(frames) == false) {
+            mFailed = true;
+            return false;
+        }
+    }
+    mRenderedFrames = rendered + frames;
+    stream_.streamTime = double(rendered + frames) / stream_.sampleRate;
+    return callbackResult == 0;
+}
+
+void RtApiOfflineStream::processInput()
+{
+    char *buffer = stream_.doConvertBuffer[RtApi::INPUT] ? stream_.deviceBuffer.get()
+                                                          : stream_.userBuffer[RtApi::INPUT].get();
+    if (mInput) {
+        // The last period is padded with silence.
+        unsigned int frameBytes = mInput->format().frameBytes();
+        uint64_t read = mInput->read(buffer, stream_.bufferSize);
+        memset(buffer + read * frameBytes, 0, (stream_.bufferSize - read) * frameBytes);
+    } else {
+        generateInput(buffer);
+    }
+
+    if (stream_.doConvertBuffer[RtApi::INPUT])
+        RtApi::convertBuffer(stream_,
+                             stream_.userBuffer[RtApi::INPUT].get(),
+                             stream_.deviceBuffer.get(),
+                             stream_.convertInfo[RtApi::INPUT],
+                             stream_.bufferSize,
+                             RtApi::INPUT);
+}
+
+bool RtApiOfflineStream::processOutput(unsigned int frames)
+{
+    char *buffer = stream_.userBuffer[RtApi::OUTPUT].get();
+    if (stream_.doConvertBuffer[RtApi::OUTPUT]) {
+        buffer = stream_.deviceBuffer.get();
+        RtApi::convertBuffer(stream_,
+                             buffer,
+                             stream_.userBuffer[RtApi::OUTPUT].get(),
+                             stream_.convertInfo[RtApi::OUTPUT],
+                             stream_.bufferSize,
+                             RtApi::OUTPUT);
+    }
+    if (mOutput)
+        return mOutput->write(buffer, frames);
+    size_t bytes = size_t(frames) * stream_.nDeviceChannels[RtApi::OUTPUT]
+                   * RtApi::formatBytes(stream_.deviceFormat[RtApi::OUTPUT]);
+    mRenderedOutput.insert(mRenderedOutput.end(), buffer, buffer + bytes);
+    return true;
+}
+
+void RtApiOfflineStream::generateInput(char *buffer)
+{
+    // Synthetic input is FLOAT32, converted to the user format like device input.
+    float *out = reinterpret_cast<float *>(buffer);
+    unsigned int channels = stream_.nDeviceChannels[RtApi::INPUT];
+    double increment = TWO_PI * mConfig.sineFrequency / stream_.sampleRate;
+    for (unsigned int i = 0; i < stream_.bufferSize; i++) {
+        float value = 0.0f;
+        switch (mConfig.inputSignal) {
+        case OfflineInputSignal::SINE:
+            value = OFFLINE_SIGNAL_AMPLITUDE * float(std::sin(mSinePhase));
+            mSinePhase = std::fmod(mSinePhase + increment, TWO_PI);
+            break;
+        case OfflineInputSignal::NOISE:
+            // xorshift32, deterministic so renders are reproducible.
+            mNoiseState ^= mNoiseState << 13;
+            mNoiseState ^= mNoiseState >> 17;
+            mNoiseState ^= mNoiseState << 5;
+            value = OFFLINE_SIGNAL_AMPLITUDE * (float(mNoiseState) / 2147483648.0f - 1.0f);
+            break;
+        case OfflineInputSignal::SILENCE:
+            break;
+        }
+        for (unsigned int c = 0; c < channels; c++)
+            out[i * channels + c] = value;
+    }
+}
+
+bool RtApiOfflineStream::isOutputFinalized() const
+{
+    return mOutput && mOutput->isOpen() == false;
+}
+
+RtAudioErrorType RtApiOfflineStream::finishRender()
+{
+    bool success = mFailed == false;
+    if (mOutput && mOutput->isOpen())
+        success = mOutput->close() && success;
+    return success ? RTAUDIO_NO_ERROR : RTAUDIO_SYSTEM_ERROR;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "RtAudio.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class RtApiOfflineStream;
+class ThreadSuspendable;
+class WavFileReader;
+class WavFileWriter;
+
+//! Input of offline streams without an input file.
+enum class OfflineInputSignal { SILENCE, SINE, NOISE };
+
+struct OfflineRenderConfig
+{
+    std::string inputFile;  /*!< WAV or RF64 file used as input, a synthetic signal if empty. */
+    OfflineInputSignal inputSignal = OfflineInputSignal::SILENCE;
+    double sineFrequency = 1000.0;
+    std::string outputFile; /*!< WAV file receiving the output, kept in memory if empty. */
+    unsigned long long lengthFrames = 0; /*!< 0 renders to the end of the input file or until the callback stops. */
+};
+
+//! Creates streams that render faster than real time.
+/*!
+  The callback is invoked back to back without any device, with the
+  input taken from a file or a synthetic signal.  The stream time
+  advances with the rendered frames, so the callback sees the same
+  timeline as on a device.  The streams report RTAUDIO_DUMMY as api.
+*/
+class RTAUDIO_DLL_PUBLIC RtApiOfflineStreamFactory : public RtApiStreamClassFactory
+{
+public:
+    explicit RtApiOfflineStreamFactory(OfflineRenderConfig config = {});
+    RtAudio::Api getCurrentApi(void) override { return RtAudio::RTAUDIO_DUMMY; }
+    std::shared_ptr<RtApiStreamClass> createStream(CreateStreamParams params) override;
+
+    std::shared_ptr<RtApiOfflineStream> createOfflineStream(CreateStreamParams params);
+
+private:
+    OfflineRenderConfig mConfig;
+};
+
+class RTAUDIO_DLL_PUBLIC RtApiOfflineStream : public RtApiStreamClass
+{
+public:
+    RtApiOfflineStream(RtApi::RtApiStream stream,
+                       OfflineRenderConfig config,
+                       std::unique_ptr<WavFileReader> input,
+                       std::unique_ptr<WavFileWriter> output);
+    ~RtApiOfflineStream();
+    RtAudio::Api getCurrentApi(void) override { return RtAudio::RTAUDIO_DUMMY; }
+
+    //! Renders on a worker thread, isStreamRunning() turns false at the end.
+    /*!
+      Once the end was rendered the output file is complete, the stream
+      cannot be started again.
+    */
+    RtAudioErrorType startStream(void) override;
+    RtAudioErrorType stopStream(void) override;
+
+    //! Renders on the calling thread until the end. The stream must be stopped.
+    RtAudioErrorType render(void);
+
+    unsigned long long getRenderedFrames(void) const { return mRenderedFrames; }
+    //! Output of streams without output file, interleaved in the user format. Read it once the stream stopped.
+    /*!
+      An output file is complete once the end was rendered or the
+      stream is destroyed.
+    */
+    const std::vector<char> &getRenderedOutput(void) const { return mRenderedOutput; }
+
+private:
+    bool threadMethod();
+    bool renderPeriod();
+    void processInput();
+    bool processOutput(unsigned int frames);
+    void generateInput(char *buffer);
+    bool isOutputFinalized() const;
+    RtAudioErrorType finishRender();
+
+    OfflineRenderConfig mConfig;
+    std::unique_ptr<WavFileReader> mInput;
+    std::unique_ptr<WavFileWriter> mOutput;
+    std::vector<char> mRenderedOutput;
+    std::atomic<unsigned long long> mRenderedFrames = 0;
+    double mSinePhase = 0;
+    uint32_t mNoiseState = 0x12345678;
+    bool mFailed = false;
+
+    // Declared last, so the thread is stopped before the members above go away.
+    std::unique_ptr<ThreadSuspendable> mThread;
+};
@@ -52,6 +52,8 @@
 #include <codecvt>
 #include <locale>
 #include "utils.h"
+#include "XrunStatistics.h"
+#include "StreamBufferArena.h"
 
 #if defined(_WIN32)
 #include <windows.h>
@@ -113,6 +115,14 @@ const unsigned int RtAudio::SAMPLE_RATES[] = {
 
 #endif
 
+#if defined(__RTAUDIO_DUMMY__)
+
+#include "dummy/RtApiDummyEnumerator.h"
+#include "dummy/RtApiDummyProber.h"
+#include "dummy/RtApiDummyStreamFactory.h"
+
+#endif
+
 std::string RtAudio::getVersion(void)
 {
     return RTAUDIO_VERSION;
@@ -169,20 +179,12 @@ extern "C" {
 static_assert(rtaudio_num_api_names == RtAudio::NUM_APIS);
 
 namespace {
-    bool allocateUserBuffer(RtApi::RtApiStream& stream_, RtApi::StreamMode mode)
+    unsigned long getUserBufferBytes(const RtApi::RtApiStream& stream_, RtApi::StreamMode mode)
     {
-        unsigned long bufferBytesOutput = stream_.nUserChannels[mode] * stream_.bufferSize * RtApi::formatBytes(stream_.userFormat);
-        if (bufferBytesOutput == 0) {
-            return true;
-        }
-        stream_.userBuffer[mode] = std::shared_ptr<char[]>(new char[bufferBytesOutput]);
-        if (stream_.userBuffer[mode] == nullptr) {
-            return false;
-        }
-        return true;
+        return stream_.nUserChannels[mode] * stream_.bufferSize * RtApi::formatBytes(stream_.userFormat);
     }
 
-    bool allocateDeviceBuffer(RtApi::RtApiStream& stream_) {
+    unsigned long getDeviceBufferBytes(const RtApi::RtApiStream& stream_) {
         unsigned long maxBuffferSize = 0;
 
         if (stream_.doConvertBuffer[RtApi::OUTPUT] && stream_.nDeviceChannels[RtApi::OUTPUT] > 0) {
@@ -194,18 +196,57 @@ namespace {
             unsigned long bufferBytesOutput = stream_.nDeviceChannels[RtApi::INPUT] * stream_.bufferSize * RtApi::formatBytes(stream_.deviceFormat[RtApi::INPUT]);
             maxBuffferSize = std::max(maxBuffferSize, bufferBytesOutput);
         }
+        return maxBuffferSize;
+    }
+
+    // The returned pointer shares ownership of the arena, so the arena
+    // lives as long as any of the buffers carved from it.
+    std::shared_ptr<char[]> allocateFromArena(const std::shared_ptr<StreamBufferArena>& arena, unsigned long bytes)
+    {
+        if (bytes == 0)
+            return {};
+        char* block = arena->allocate(bytes);
+        if (!block)
+            return {};
+        return std::shared_ptr<char[]>(arena, block);
+    }
 
-        if (maxBuffferSize == 0)
+    bool allocateStreamBuffers(RtApi::RtApiStream& stream_)
+    {
+        unsigned long userBytes[2] = { getUserBufferBytes(stream_, RtApi::OUTPUT),
+                                       getUserBufferBytes(stream_, RtApi::INPUT) };
+        unsigned long deviceBytes = getDeviceBufferBytes(stream_);
+        size_t capacity = StreamBufferArena::alignedSize(userBytes[RtApi::OUTPUT])
+            + StreamBufferArena::alignedSize(userBytes[RtApi::INPUT])
+            + StreamBufferArena::alignedSize(deviceBytes);
+        if (capacity == 0)
             return true;
 
-        stream_.deviceBuffer = std::shared_ptr<char[]>(new char[maxBuffferSize]);
-        if (!stream_.deviceBuffer) {
+        // Reuse the current arena if the buffers still fit, so resizing a
+        // stream does not map and prefault new memory.
+        std::shared_ptr<StreamBufferArena> arena = stream_.bufferArena;
+        if (arena && arena->capacity() >= capacity) {
+            stream_.userBuffer[RtApi::OUTPUT].reset();
+            stream_.userBuffer[RtApi::INPUT].reset();
+            stream_.deviceBuffer.reset();
+            arena->reset();
+        } else {
+            arena = std::make_shared<StreamBufferArena>(capacity, stream_.hugePageBuffers);
+        }
+        if (arena->isValid() == false)
+            return false;
+
+        stream_.userBuffer[RtApi::OUTPUT] = allocateFromArena(arena, userBytes[RtApi::OUTPUT]);
+        stream_.userBuffer[RtApi::INPUT] = allocateFromArena(arena, userBytes[RtApi::INPUT]);
+        stream_.deviceBuffer = allocateFromArena(arena, deviceBytes);
+        if ((userBytes[RtApi::OUTPUT] && !stream_.userBuffer[RtApi::OUTPUT]) ||
+            (userBytes[RtApi::INPUT] && !stream_.userBuffer[RtApi::INPUT]) ||
+            (deviceBytes && !stream_.deviceBuffer)) {
             return false;
         }
+        stream_.bufferArena = std::move(arena);
         return true;
     }
-
-
 }
 void RtAudio::getCompiledApi(std::vector<RtAudio::Api>& apis)
 {
@@ -325,7 +366,7 @@ std::shared_ptr<RtApiEnumerator> RtAudio::GetRtAudioEnumerator(RtAudio::Api api)
 #endif
 #if defined(__RTAUDIO_DUMMY__)
     if (api == RTAUDIO_DUMMY)
-        rtapi_ = new RtApiDummy();
+        return std::make_shared<RtApiDummyEnumerator>();
 #endif
     return {};
 }
@@ -351,6 +392,10 @@ std::shared_ptr<RtApiProber> RtAudio::GetRtAudioProber(RtAudio::Api api)
 #if defined(__WINDOWS_WASAPI__)
     if (api == RtAudio::WINDOWS_WASAPI)
         return std::make_shared<RtApiWasapiProber>();
+#endif
+#if defined(__RTAUDIO_DUMMY__)
+    if (api == RTAUDIO_DUMMY)
+        return std::make_shared<RtApiDummyProber>();
 #endif
     return {};
 }
@@ -376,6 +421,10 @@ std::shared_ptr<RtApiStreamClassFactory> RtAudio::GetRtAudioStreamFactory(RtAudi
 #if defined(__WINDOWS_WASAPI__)
     if (api == RtAudio::WINDOWS_WASAPI)
         return std::make_shared<RtApiWasapiStreamFactory>();
+#endif
+#if defined(__RTAUDIO_DUMMY__)
+    if (api == RTAUDIO_DUMMY)
+        return std::make_shared<RtApiDummyStreamFactory>();
 #endif
     return {};
 }
@@ -397,7 +446,7 @@ std::shared_ptr<RtApiSystemCallback> RtAudio::GetRtAudioSystemCallback(RtAudio::
     return {};
 }
 
-void RtApi::convertBuffer(const RtApi::RtApiStream stream_,
+void RtApi::convertBuffer(const RtApi::RtApiStream& stream_,
                           char *outBuffer,
                           const char *inBuffer,
                           RtApi::ConvertInfo info,
@@ -848,7 +897,10 @@ unsigned int RtApi::formatBytes(RtAudioFormat format) {
     return 0;
 }
 
-RtApiStreamClass::RtApiStreamClass(RtApi::RtApiStream stream) : stream_(std::move(stream)) {
+RtApiStreamClass::RtApiStreamClass(RtApi::RtApiStream stream)
+    : stream_(std::move(stream))
+    , mXrunStatistics(std::make_unique<XrunStatistics>())
+{
     stream_.state = RtApi::StreamState::STREAM_STOPPED;
     MUTEX_INITIALIZE(&stream_.mutex);
 }
@@ -858,8 +910,7 @@ RtApiStreamClass::~RtApiStreamClass()
     MUTEX_DESTROY(&stream_.mutex);
 }
 
-bool RtApiStreamClass::isStreamRunning() {
-    MutexRaii<StreamMutex> lock(stream_.mutex);
+bool RtApiStreamClass::isStreamRunning() const {
     return stream_.state == RtApi::StreamState::STREAM_RUNNING && stream_.errorState == false;
 }
 
@@ -868,6 +919,86 @@ unsigned int RtApiStreamClass::getBufferSize(void) const
     return stream_.bufferSize;
 }
 
+long RtApiStreamClass::getStreamLatency(void) const
+{
+    long totalLatency = 0;
+    if (stream_.mode == RtApi::OUTPUT || stream_.mode == RtApi::DUPLEX)
+        totalLatency = stream_.latency[RtApi::OUTPUT];
+    if (stream_.mode == RtApi::INPUT || stream_.mode == RtApi::DUPLEX)
+        totalLatency += stream_.latency[RtApi::INPUT];
+    return totalLatency;
+}
+
+RtAudioXrunStatistics RtApiStreamClass::getXrunStatistics(void) const
+{
+    return mXrunStatistics->snapshot();
+}
+
+void RtApiStreamClass::registerXrun(RtAudioStreamStatus type,
+                                    unsigned long long timestampNs,
+                                    unsigned long framesLost,
+                                    unsigned long long recoveryNs)
+{
+    mXrunStatistics->record(type, timestampNs, framesLost, recoveryNs);
+}
+
+RtAudioErrorType RtApiStreamClass::reconfigure(unsigned int /*bufferSize*/, unsigned int /*sampleRate*/)
+{
+    return error(RTAUDIO_INVALID_USE, "RtApiStreamClass::reconfigure: not supported by this API.");
+}
+
+bool RtApiStreamClass::resizeStreamBuffers(unsigned int bufferSize, unsigned int sampleRate)
+{
+    stream_.sampleRate = sampleRate;
+    if (stream_.bufferSize == bufferSize)
+        return true;
+    stream_.bufferSize = bufferSize;
+    if (allocateStreamBuffers(stream_) == false) {
+        error(RTAUDIO_MEMORY_ERROR, "RtApiStreamClass::resizeStreamBuffers: error allocating stream buffer memory.");
+        return false;
+    }
+    RtApi::setConvertInfo(RtApi::OUTPUT, stream_);
+    RtApi::setConvertInfo(RtApi::INPUT, stream_);
+    return true;
+}
+
+RtAudioErrorType RtApiStreamClass::warmStream()
+{
+    return error(RTAUDIO_INVALID_USE, "RtApiStreamClass::warmStream: not supported by this API.");
+}
+
+RtAudioErrorType RtApiStreamClass::pauseStream()
+{
+    return error(RTAUDIO_INVALID_USE, "RtApiStreamClass::pauseStream: not supported by this API.");
+}
+
+RtAudioErrorType RtApiStreamClass::resumeStream()
+{
+    return error(RTAUDIO_INVALID_USE, "RtApiStreamClass::resumeStream: not supported by this API.");
+}
+
+void RtApiStreamClass::setStreamFinishedCallback(RtAudioStreamFinishedCallback callback)
+{
+    mStreamFinishedCallback = callback;
+}
+
+void RtApiStreamClass::notifyStreamFinished(RtAudioErrorType type)
+{
+    if (mStreamFinishedCallback)
+        mStreamFinishedCallback(type);
+}
+
+void RtApiStreamClass::setLatencyChangedCallback(RtAudioLatencyChangedCallback callback)
+{
+    mLatencyChangedCallback = callback;
+}
+
+void RtApiStreamClass::notifyLatencyChanged(unsigned long latencyFrames)
+{
+    if (mLatencyChangedCallback)
+        mLatencyChangedCallback(latencyFrames);
+}
+
 RtAudioErrorType RtApiStreamClass::startStreamCheck()
 {
     if (stream_.state != RtApi::STREAM_STOPPED) {
@@ -993,6 +1124,8 @@ void RtApi::setConvertInfo(RtApi::StreamMode mode, RtApi::RtApiStream& stream_)
         stream_.convertInfo[mode].channels = stream_.convertInfo[mode].outJump;
 
     // Set up the interleave/deinterleave offsets.
+    stream_.convertInfo[mode].inOffset.clear();
+    stream_.convertInfo[mode].outOffset.clear();
     if (stream_.deviceInterleaved[mode] != stream_.userInterleaved) {
         if ((mode == RtApi::OUTPUT && stream_.deviceInterleaved[mode]) ||
             (mode == RtApi::INPUT && stream_.userInterleaved)) {
@@ -1068,17 +1201,13 @@ bool RtApiStreamClassFactory::setupStreamCommon(RtApi::RtApiStream& stream_)
     if (stream_.userInterleaved != stream_.deviceInterleaved[RtApi::INPUT] &&
         stream_.nUserChannels[RtApi::INPUT] > 1)
         stream_.doConvertBuffer[RtApi::INPUT] = true;
+    if (stream_.nUserChannels[RtApi::OUTPUT] < stream_.nDeviceChannels[RtApi::OUTPUT])
+        stream_.doConvertBuffer[RtApi::OUTPUT] = true;
+    if (stream_.nUserChannels[RtApi::INPUT] < stream_.nDeviceChannels[RtApi::INPUT])
+        stream_.doConvertBuffer[RtApi::INPUT] = true;
 
-    if (allocateUserBuffer(stream_, RtApi::OUTPUT) == false) {
-        error(RTAUDIO_MEMORY_ERROR, "RtApiAsio::probeDeviceOpen: error allocating user buffer memory.");
-        return false;
-    }
-    if (allocateUserBuffer(stream_, RtApi::INPUT) == false) {
-        error(RTAUDIO_MEMORY_ERROR, "RtApiAsio::probeDeviceOpen: error allocating user buffer memory.");
-        return false;
-    }
-    if (allocateDeviceBuffer(stream_) == false) {
-        error(RTAUDIO_MEMORY_ERROR, "RtApiAsio::probeDeviceOpen: error allocating user buffer memory.");
+    if (allocateStreamBuffers(stream_) == false) {
+        error(RTAUDIO_MEMORY_ERROR, "RtApiStreamClassFactory::setupStreamCommon: error allocating stream buffer memory.");
         return false;
     }
     RtApi::setConvertInfo(RtApi::OUTPUT, stream_);
@@ -1101,6 +1230,8 @@ bool RtApiStreamClassFactory::setupStreamWithParams(RtApi::RtApiStream& stream_,
             stream_.callbackInfo.doRealtime = false;
 
         stream_.callbackInfo.priority = params.options->priority;
+        stream_.hugePageBuffers = (params.options->flags & RTAUDIO_HUGE_PAGE_BUFFERS) != 0;
+        stream_.adaptiveLatency = (params.options->flags & RTAUDIO_ADAPTIVE_LATENCY) != 0;
     }
     stream_.sampleRate = params.sampleRate;
     stream_.deviceId = params.busId;
@@ -85,6 +85,7 @@
 #include <functional>
 #include <optional>
 #include <memory>
+#include <atomic>
 
  /*! \typedef typedef unsigned long RtAudioFormat;
      \brief RtAudio data format type.
@@ -123,6 +124,9 @@ static const RtAudioFormat RTAUDIO_FLOAT64 = 0x20; // Normalized between plus/mi
     - \e RTAUDIO_HOG_DEVICE:       Attempt grab device for exclusive use.
     - \e RTAUDIO_ALSA_USE_DEFAULT: Use the "default" PCM device (ALSA only).
     - \e RTAUDIO_JACK_DONT_CONNECT: Do not automatically connect ports (JACK only).
+    - \e RTAUDIO_HUGE_PAGE_BUFFERS: Try to back the stream buffers with huge pages.
+    - \e RTAUDIO_VARIABLE_RATE: Allow reconfigure() to change the sample rate (PulseAudio only).
+    - \e RTAUDIO_ADAPTIVE_LATENCY: Adjust the output safety margin to xruns and callback load.
 
     By default, RtAudio streams pass and receive audio data from the
     client in an interleaved format.  By passing the
@@ -157,6 +161,25 @@ static const RtAudioFormat RTAUDIO_FLOAT64 = 0x20; // Normalized between plus/mi
 
     If the RTAUDIO_JACK_DONT_CONNECT flag is set, RtAudio will not attempt
     to automatically connect the ports of the client to the audio device.
+
+    Stream buffers are always allocated from a single 64-byte aligned
+    region that is prefaulted and, if permitted, locked in memory when
+    the stream is created.  If the RTAUDIO_HUGE_PAGE_BUFFERS flag is set,
+    RtAudio will try to back that region with huge pages and fall back
+    to regular pages if none are available.
+
+    PulseAudio can only change the sample rate of an open stream if it
+    was created with the RTAUDIO_VARIABLE_RATE flag.  The flag makes the
+    server resample the stream even at its native rate, so it is off
+    by default.
+
+    If the RTAUDIO_ADAPTIVE_LATENCY flag is set, output streams start
+    with two periods queued on the device and add a period after every
+    xrun or when the callback takes more than three quarters of a period.
+    After ten seconds without xruns and at low load one period is removed
+    again.  The queue never grows beyond numberOfBuffers (at least eight
+    in this mode).  Every change is reported through the stream's
+    RtAudioLatencyChangedCallback.
 */
 typedef unsigned int RtAudioStreamFlags;
 static const RtAudioStreamFlags RTAUDIO_NONINTERLEAVED = 0x1;    // Use non-interleaved buffers (default = interleaved).
@@ -166,6 +189,9 @@ static const RtAudioStreamFlags RTAUDIO_SCHEDULE_REALTIME = 0x8; // Try to selec
 static const RtAudioStreamFlags RTAUDIO_ALSA_USE_DEFAULT = 0x10; // Use the "default" PCM device (ALSA only).
 static const RtAudioStreamFlags RTAUDIO_JACK_DONT_CONNECT = 0x20; // Do not automatically connect ports (JACK only).
 static const RtAudioStreamFlags RTAUDIO_ALSA_NONBLOCK = 0x40; // Use non-block mode for alsa io.
+static const RtAudioStreamFlags RTAUDIO_HUGE_PAGE_BUFFERS = 0x80; // Try to back the stream buffers with huge pages.
+static const RtAudioStreamFlags RTAUDIO_VARIABLE_RATE = 0x100; // Allow reconfigure() to change the sample rate (PulseAudio only).
+static const RtAudioStreamFlags RTAUDIO_ADAPTIVE_LATENCY = 0x200; // Adjust the output safety margin to xruns and callback load.
 
 /*! \typedef typedef unsigned long RtAudioStreamStatus;
     \brief RtAudio stream status (over- or underflow) flags.
@@ -182,6 +208,33 @@ typedef unsigned int RtAudioStreamStatus;
 static const RtAudioStreamStatus RTAUDIO_INPUT_OVERFLOW = 0x1;    // Input data was discarded because of an overflow condition at the driver.
 static const RtAudioStreamStatus RTAUDIO_OUTPUT_UNDERFLOW = 0x2;  // The output buffer ran low, likely causing a gap in the output sound.
 
+//! A single stream over- or underflow as recorded by the stream.
+/*!
+    The \c timestampNs value is taken from the monotonic (steady)
+    clock, which is CLOCK_MONOTONIC on Linux, so that xruns can be
+    correlated with other system events.  \c framesLost is an estimate
+    and is zero when the API does not report it.
+*/
+struct RtAudioXrunEvent {
+    RtAudioStreamStatus type{};           /*!< RTAUDIO_INPUT_OVERFLOW or RTAUDIO_OUTPUT_UNDERFLOW. */
+    unsigned long long timestampNs{};     /*!< Monotonic time the xrun was detected, in nanoseconds. */
+    unsigned long framesLost{};           /*!< Frames dropped (input) or played as silence (output). */
+    unsigned long long recoveryNs{};      /*!< Time spent restarting the device, in nanoseconds. */
+};
+
+//! Xrun totals and the most recent xrun events of a stream.
+struct RtAudioXrunStatistics {
+    unsigned long long outputUnderflows{};    /*!< Number of output underflows. */
+    unsigned long long outputFramesLost{};    /*!< Sum of framesLost over all output underflows. */
+    unsigned long long outputRecoveryNs{};    /*!< Total time spent recovering from output underflows. */
+    unsigned long long outputMaxRecoveryNs{}; /*!< Longest single output recovery. */
+    unsigned long long inputOverflows{};      /*!< Number of input overflows. */
+    unsigned long long inputFramesLost{};     /*!< Sum of framesLost over all input overflows. */
+    unsigned long long inputRecoveryNs{};     /*!< Total time spent recovering from input overflows. */
+    unsigned long long inputMaxRecoveryNs{};  /*!< Longest single input recovery. */
+    std::vector<RtAudioXrunEvent> recentEvents; /*!< Most recent events, oldest first. */
+};
+
 //! RtAudio callback function prototype.
 /*!
    All RtAudio clients must create a function of type RtAudioCallback
@@ -264,6 +317,24 @@ typedef std::function<void(RtAudioErrorType type,
     const std::string& errorText)>
     RtAudioErrorCallback;
 
+//! RtAudio stream finished notification prototype.
+/*!
+   Invoked from the audio thread once a stream stopped on its own because
+   its RtAudioCallback returned one (drain) or two (abort).  \c type is
+   RTAUDIO_NO_ERROR if the output was drained or dropped successfully.
+   The stream is stopped when this is called and may be restarted.
+ */
+typedef std::function<void(RtAudioErrorType type)> RtAudioStreamFinishedCallback;
+
+//! RtAudio adaptive latency notification prototype.
+/*!
+   Invoked from the audio thread whenever a stream opened with
+   RTAUDIO_ADAPTIVE_LATENCY changed the amount of output it keeps
+   queued.  \c latencyFrames is the new target in sample frames.
+ */
+typedef std::function<void(unsigned long latencyFrames)> RtAudioLatencyChangedCallback;
+
+
 // **************************************************************** //
 //
 // RtAudio class declaration.
@@ -283,6 +354,8 @@ class RtApiStreamClassFactory;
 class RtApiProber;
 class RtApiEnumerator;
 class RtApiSystemCallback;
+class XrunStatistics;
+class StreamBufferArena;
 
 
 class RTAUDIO_DLL_PUBLIC RtAudio
@@ -300,7 +373,7 @@ public:
         LINUX_PULSE,    /*!< The Linux PulseAudio API. */
         WINDOWS_ASIO,   /*!< The Steinberg Audio Stream I/O API. */
         WINDOWS_WASAPI, /*!< The Microsoft WASAPI API. */
-        RTAUDIO_DUMMY,  /*!< A compilable but non-functional API. */
+        RTAUDIO_DUMMY,  /*!< Virtual devices clocked by a timer, no audio hardware needed. */
         NUM_APIS        /*!< Number of values in this enum. */
     };
 
@@ -377,8 +450,8 @@ public:
       will override any specified input or output device id.
 
       The \c numberOfBuffers parameter can be used to control stream
-      latency in the Windows DirectSound, Linux OSS, and Linux Alsa APIs
-      only.  A value of two is usually the smallest allowed.  Larger
+      latency in the Windows DirectSound, Linux OSS, Linux Alsa and Linux
+      Pulse APIs only.  A value of two is usually the smallest allowed.  Larger
       numbers can potentially result in more robust stream performance,
       though likely at the cost of stream latency.  The value set by the
       user is replaced during execution of the RtAudio::openStream()
@@ -467,7 +540,7 @@ typedef pthread_mutex_t StreamMutex;
 // Setup for "dummy" behavior if no apis specified.
 #if !(defined(__WINDOWS_DS__) || defined(__WINDOWS_ASIO__) || defined(__WINDOWS_WASAPI__) \
       || defined(__LINUX_ALSA__) || defined(__LINUX_PULSE__) || defined(__UNIX_JACK__) \
-      || defined(__LINUX_OSS__) || defined(__MACOSX_CORE__))
+      || defined(__LINUX_OSS__) || defined(__MACOSX_CORE__) || defined(__RTAUDIO_DUMMY__))
 
 #define __RTAUDIO_DUMMY__
 
@@ -488,6 +561,26 @@ struct CallbackInfo {
     bool deviceDisconnected{ false };
 };
 
+// An atomic value that occupies a cache line of its own, so that
+// control threads polling it never share a line with data written by
+// the audio thread. Copying takes a snapshot, which lets it live in
+// RtApiStream.
+template<class T>
+struct alignas(64) CacheLineAtomic {
+    CacheLineAtomic(T value = T{}) : value_(value) {}
+    CacheLineAtomic(const CacheLineAtomic& other) : value_(other.load()) {}
+    CacheLineAtomic& operator = (const CacheLineAtomic& other) { store(other.load()); return *this; }
+    CacheLineAtomic& operator = (T value) { store(value); return *this; }
+    operator T() const { return load(); }
+
+    T load() const { return value_.load(std::memory_order_acquire); }
+    void store(T value) { value_.store(value, std::memory_order_release); }
+    bool compareExchange(T& expected, T desired) { return value_.compare_exchange_strong(expected, desired); }
+
+private:
+    std::atomic<T> value_;
+};
+
 #pragma pack(push, 1)
 class S24 {
 
@@ -533,6 +626,8 @@ public:
         STREAM_STOPPING,
         STREAM_RUNNING,
         STREAM_ERROR,
+        STREAM_WARM,    // Device running on silence, callback not invoked.
+        STREAM_PAUSED,  // Device paused, position kept.
         STREAM_CLOSED = -50
     };
     // A protected structure used for buffer conversion.
@@ -548,8 +643,11 @@ public:
         std::string deviceId;
         void* apiHandle;           // void pointer for API specific stream handle information
         StreamMode mode;           // OUTPUT, INPUT, or DUPLEX.
-        StreamState state;         // STOPPED, RUNNING, or CLOSED
-        bool errorState = false;   //TODO: add mutex or make atomic
+        CacheLineAtomic<StreamState> state;   // STOPPED, RUNNING, or CLOSED
+        CacheLineAtomic<bool> errorState = false;
+        std::shared_ptr<StreamBufferArena> bufferArena; // Backing memory of the buffers below.
+        bool hugePageBuffers = false;
+        bool adaptiveLatency = false;
         std::shared_ptr<char[]> userBuffer[2];       // Playback and record, respectively.
         std::shared_ptr<char[]> deviceBuffer;
         bool doConvertBuffer[2];   // Playback and record, respectively.
@@ -562,7 +660,7 @@ public:
         unsigned int nUserChannels[2];    // Playback and record, respectively.
         unsigned int nDeviceChannels[2];  // Playback and record channels, respectively.
         unsigned int channelOffset[2];    // Playback and record, respectively.
-        unsigned long latency[2];         // Playback and record, respectively.
+        CacheLineAtomic<unsigned long> latency[2]; // Playback and record, respectively.
         RtAudioFormat userFormat;
         RtAudioFormat deviceFormat[2];    // Playback and record, respectively.
         StreamMutex mutex;
@@ -572,7 +670,7 @@ public:
     };
 
     static unsigned int formatBytes(RtAudioFormat format);
-    static void convertBuffer(const RtApi::RtApiStream stream_,
+    static void convertBuffer(const RtApi::RtApiStream& stream_,
                               char *outBuffer,
                               const char *inBuffer,
                               RtApi::ConvertInfo info,
@@ -636,16 +734,67 @@ public:
     virtual RtAudioErrorType startStream(void) = 0;
     virtual RtAudioErrorType stopStream(void) = 0;
 
-    bool isStreamRunning();
+    //! Starts the device on silence without invoking the callback.
+    /*!
+      A following startStream() only enables the callback, which is
+      then invoked for the next device period.  Calling it on a running
+      stream disables the callback again and keeps the device running.
+    */
+    virtual RtAudioErrorType warmStream(void);
+    //! Pauses a running or warm stream, keeping the device position where supported.
+    virtual RtAudioErrorType pauseStream(void);
+    //! Continues a paused stream in the state it had before pauseStream().
+    virtual RtAudioErrorType resumeStream(void);
+
+    //! Changes the buffer size and sample rate of a stopped or paused stream.
+    /*!
+      The open device handle is reused and the stream buffers are
+      resized in place.  The device may round \c bufferSize, use
+      getBufferSize() for the value in effect.  A paused stream stays
+      paused and continues with the new settings on resumeStream().
+    */
+    virtual RtAudioErrorType reconfigure(unsigned int bufferSize, unsigned int sampleRate);
+
+    //! Lock-free, safe to call from any thread.
+    bool isStreamRunning() const;
 
     double getStreamTime(void) const { return stream_.streamTime; }
     void tickStreamTime(void) { stream_.streamTime += (stream_.bufferSize * 1.0 / stream_.sampleRate); }
     unsigned int getBufferSize(void) const;
+    //! Returns the latency reported by the device in sample frames, input and output added for duplex streams.
+    long getStreamLatency(void) const;
+
+    //! Returns xrun totals and the most recent xrun events. Safe to call while the stream runs.
+    RtAudioXrunStatistics getXrunStatistics(void) const;
+
+    //! Sets the notification for streams stopped by the callback return value. Set it before starting the stream.
+    void setStreamFinishedCallback(RtAudioStreamFinishedCallback callback);
+    //! Sets the notification for RTAUDIO_ADAPTIVE_LATENCY changes. Set it before starting the stream.
+    void setLatencyChangedCallback(RtAudioLatencyChangedCallback callback);
 protected:
     RtAudioErrorType startStreamCheck();
     RtAudioErrorType stopStreamCheck();
 
+    // Called from the audio thread whenever an over- or underflow was handled.
+    void registerXrun(RtAudioStreamStatus type,
+                      unsigned long long timestampNs,
+                      unsigned long framesLost,
+                      unsigned long long recoveryNs);
+
+    // Updates the stream parameters and reallocates the buffers for a new buffer size.
+    bool resizeStreamBuffers(unsigned int bufferSize, unsigned int sampleRate);
+
+    // Called from the audio thread after the stream stopped itself on a drain or abort request.
+    void notifyStreamFinished(RtAudioErrorType type);
+    // Called from the audio thread after the adaptive latency target changed.
+    void notifyLatencyChanged(unsigned long latencyFrames);
+
     RtApi::RtApiStream stream_;
+
+private:
+    std::unique_ptr<XrunStatistics> mXrunStatistics;
+    RtAudioStreamFinishedCallback mStreamFinishedCallback = nullptr;
+    RtAudioLatencyChangedCallback mLatencyChangedCallback = nullptr;
 };
 
 struct CreateStreamParams {
@@ -0,0 +1,124 @@
+#include "StreamBufferArena.h"
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+size_t roundUp(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+size_t getPageSize()
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info{};
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? static_cast<size_t>(size) : 4096;
+#endif
+}
+} // namespace
+
+StreamBufferArena::StreamBufferArena(size_t capacity, bool hugePages)
+{
+    if (capacity == 0)
+        return;
+    if (hugePages && map(roundUp(capacity, HUGE_PAGE_SIZE), true)) {
+        mHugePages = true;
+    } else if (!map(roundUp(capacity, getPageSize()), false)) {
+        return;
+    }
+    mCapacity = mMappedSize;
+    prefaultAndLock();
+}
+
+StreamBufferArena::~StreamBufferArena()
+{
+    if (!mData)
+        return;
+#if defined(_WIN32)
+    if (mLocked)
+        VirtualUnlock(mData, mMappedSize);
+    VirtualFree(mData, 0, MEM_RELEASE);
+#else
+    if (mLocked)
+        munlock(mData, mMappedSize);
+    munmap(mData, mMappedSize);
+#endif
+}
+
+bool StreamBufferArena::isValid() const
+{
+    return mData ? true : false;
+}
+
+char *StreamBufferArena::allocate(size_t bytes)
+{
+    size_t size = alignedSize(bytes);
+    if (!mData || size > mCapacity - mUsed)
+        return nullptr;
+    char *block = mData + mUsed;
+    mUsed += size;
+    return block;
+}
+
+size_t StreamBufferArena::alignedSize(size_t bytes)
+{
+    return roundUp(bytes, ALIGNMENT);
+}
+
+bool StreamBufferArena::map(size_t bytes, bool hugePages)
+{
+#if defined(_WIN32)
+    DWORD flags = MEM_COMMIT | MEM_RESERVE;
+    if (hugePages) {
+        SIZE_T largePage = GetLargePageMinimum();
+        if (largePage == 0)
+            return false;
+        bytes = roundUp(bytes, largePage);
+        flags |= MEM_LARGE_PAGES;
+    }
+    void *data = VirtualAlloc(nullptr, bytes, flags, PAGE_READWRITE);
+    if (!data)
+        return false;
+#else
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (hugePages) {
+#if defined(MAP_HUGETLB)
+        flags |= MAP_HUGETLB;
+#else
+        return false;
+#endif
+    }
+    void *data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (data == MAP_FAILED)
+        return false;
+#endif
+    mData = static_cast<char *>(data);
+    mMappedSize = bytes;
+    return true;
+}
+
+void StreamBufferArena::prefaultAndLock()
+{
+    // Writing every page forces the kernel to back it now instead of on
+    // the first access from the audio thread.
+    std::memset(mData, 0, mMappedSize);
+#if defined(_WIN32)
+    mLocked = VirtualLock(mData, mMappedSize) != 0;
+#else
+    // Fails without CAP_IPC_LOCK or a sufficient RLIMIT_MEMLOCK, the
+    // prefaulted pages are still used in that case.
+    mLocked = mlock(mData, mMappedSize) == 0;
+#endif
+}
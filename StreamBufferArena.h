@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+
+// One contiguous, page-backed region from which all buffers of a stream
+// are carved. The region is prefaulted and locked in memory (best effort)
+// when it is created, so the audio thread never takes a page fault on it.
+class StreamBufferArena
+{
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    StreamBufferArena(size_t capacity, bool hugePages);
+    StreamBufferArena(const StreamBufferArena &) = delete;
+    StreamBufferArena &operator=(const StreamBufferArena &) = delete;
+    ~StreamBufferArena();
+
+    bool isValid() const;
+    bool isLocked() const { return mLocked; }
+    bool usesHugePages() const { return mHugePages; }
+    size_t capacity() const { return mCapacity; }
+    size_t available() const { return mCapacity - mUsed; }
+
+    // Returns an ALIGNMENT aligned block or nullptr if the arena is exhausted.
+    char *allocate(size_t bytes);
+    // Makes the whole capacity available again. Blocks handed out before
+    // must not be used afterwards.
+    void reset() { mUsed = 0; }
+
+    static size_t alignedSize(size_t bytes);
+
+private:
+    bool map(size_t bytes, bool hugePages);
+    void prefaultAndLock();
+
+    char *mData = nullptr;
+    size_t mMappedSize = 0;
+    size_t mCapacity = 0;
+    size_t mUsed = 0;
+    bool mHugePages = false;
+    bool mLocked = false;
+};
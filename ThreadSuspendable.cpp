@@ -1,13 +1,14 @@
 #include "ThreadSuspendable.h"
+#include <algorithm>
 #include <cassert>
 
 namespace {
 #ifndef WIN32
 inline int clampPriority(int priority, int policy)
 {
-    int min = sched_get_priority_min(priority);
-    int max = sched_get_priority_max(priority);
-    return std::clamp(policy, min, max);
+    int min = sched_get_priority_min(policy);
+    int max = sched_get_priority_max(policy);
+    return std::clamp(priority, min, max);
 }
 
 static void *threadMethodJump(void *user)
@@ -18,11 +19,15 @@ static void *threadMethodJump(void *user)
     return nullptr;
 }
 
-pthread_attr_t setupAttrsPriority(int priority)
+pthread_attr_t setupAttrsPriority(bool realtime, int priority)
 {
     pthread_attr_t attr{};
     pthread_attr_init(&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    if (!realtime) {
+        pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+        return attr;
+    }
 
 #ifdef SCHED_RR // Undefined with some OSes (e.g. NetBSD 1.6.x with GNU Pthread)
     struct sched_param param
@@ -50,7 +55,7 @@ ThreadSuspendable::ThreadSuspendable(std::function<bool()> process, bool realtim
 #ifdef WIN32
     mThread = std::thread(&ThreadSuspendable::threadMethod, this);
 #else
-    pthread_attr_t attr = setupAttrsPriority(priority);
+    pthread_attr_t attr = setupAttrsPriority(realtime, priority);
     int result = pthread_create(&mThread, &attr, threadMethodJump, this);
     pthread_attr_destroy(&attr);
     if (result != 0) {
@@ -66,47 +71,48 @@ ThreadSuspendable::~ThreadSuspendable()
 
 void ThreadSuspendable::resume()
 {
-    std::unique_lock g(mMutex);
-    if (mState == State::STOPPED)
-        return;
-    if (mState == State::RESUMING || mState == State::RUNNING)
-        return;
-    mState = State::RESUMING;
-    mCV.notify_all();
+    std::lock_guard g(mControlMutex);
+    transition(State::RESUMING, {State::RUNNING, State::RESUMING, State::STOPPING, State::STOPPED});
 }
 
 void ThreadSuspendable::suspend()
 {
-    std::unique_lock g(mMutex);
-    if (mState == State::STOPPED)
-        return;
-    if (mState == State::SUSPENDED)
-        return;
-    mState = State::SUSPENDING;
-    mCV.notify_all();
-    while (mState != State::SUSPENDED) {
-        mCV.wait(g);
-    }
+    std::lock_guard g(mControlMutex);
+    transition(State::SUSPENDING, {State::SUSPENDED, State::STOPPING, State::STOPPED});
+    waitFor({State::SUSPENDED, State::STOPPED});
 }
 
 void ThreadSuspendable::stop()
 {
-    std::unique_lock g(mMutex);
-    if (mState == State::STOPPED)
-        return;
-    mState = State::STOPPING;
-    mCV.notify_all();
-    while (mState != State::STOPPED) {
-        mCV.wait(g);
-    }
+    std::lock_guard g(mControlMutex);
+    transition(State::STOPPING, {State::STOPPED});
+    waitFor({State::STOPPED});
+    join();
+}
+
+void ThreadSuspendable::requestSuspend()
+{
+    State expected = State::RUNNING;
+    mState.compare_exchange_strong(expected, State::SUSPENDING);
+}
+
+bool ThreadSuspendable::setPriority(bool realtime, int priority)
+{
 #ifdef WIN32
-    if (mThread.joinable()) {
-        mThread.join();
-    }
+    return false;
 #else
-    if (mThread) {
-        pthread_join(mThread, 0);
+    if (!isValid())
+        return false;
+    struct sched_param param
+    {};
+    int policy = SCHED_OTHER;
+#ifdef SCHED_RR
+    if (realtime) {
+        policy = SCHED_RR;
+        param.sched_priority = clampPriority(priority, SCHED_RR);
     }
+#endif
+    return pthread_setschedparam(mThread, policy, &param) == 0;
 #endif
 }
 
@@ -119,41 +125,76 @@ bool ThreadSuspendable::isValid() const
 #endif
 }
 
+bool ThreadSuspendable::transition(State to, std::initializer_list<State> ignored)
+{
+    // The audio thread may change the state concurrently (for instance
+    // to STOPPING when process() fails), so retry until it settles.
+    State current = mState.load();
+    do {
+        if (std::find(ignored.begin(), ignored.end(), current) != ignored.end())
+            return false;
+    } while (!mState.compare_exchange_weak(current, to));
+    mState.notify_all();
+    return true;
+}
+
+void ThreadSuspendable::waitFor(std::initializer_list<State> states)
+{
+    if (!isValid())
+        return;
+    State current = mState.load();
+    while (std::find(states.begin(), states.end(), current) == states.end()) {
+        mState.wait(current);
+        current = mState.load();
+    }
+}
+
+void ThreadSuspendable::join()
+{
+    if (mJoined || !isValid())
+        return;
+    mJoined = true;
+#ifdef WIN32
+    mThread.join();
+#else
+    pthread_join(mThread, 0);
+#endif
+}
+
 void ThreadSuspendable::threadMethod()
 {
-    bool lastProcessResult = true;
     while (true) {
-        {
-            std::unique_lock g(mMutex);
-            if (lastProcessResult == false) {
-                mState = State::STOPPING;
-            }
-
-            while (mState != State::RUNNING) {
-                switch (mState) {
-                case State::SUSPENDED:
-                    mCV.wait(g);
-                    break;
-                case State::RESUMING:
-                    mState = State::RUNNING;
-                    mCV.notify_all();
-                    break;
-                case State::SUSPENDING:
-                    mState = State::SUSPENDED;
-                    mCV.notify_all();
-                    break;
-                case State::STOPPING:
-                    mState = State::STOPPED;
-                    mCV.notify_all();
-                    return;
-                case State::RUNNING:
-                case State::STOPPED:
-                default:
-                    assert(false);
-                    return;
+        State state = mState.load(std::memory_order_acquire);
+        switch (state) {
+        case State::RUNNING:
+            if (mProcess() == false) {
+                State expected = State::RUNNING;
+                if (!mState.compare_exchange_strong(expected, State::STOPPING)) {
+                    // A control thread asked for something else meanwhile,
+                    // stopping takes precedence over it.
+                    mState.store(State::STOPPING);
                 }
             }
+            break;
+        case State::SUSPENDED:
+            mState.wait(State::SUSPENDED, std::memory_order_acquire);
+            break;
+        case State::RESUMING:
+            mState.compare_exchange_strong(state, State::RUNNING);
+            mState.notify_all();
+            break;
+        case State::SUSPENDING:
+            mState.compare_exchange_strong(state, State::SUSPENDED);
+            mState.notify_all();
+            break;
+        case State::STOPPING:
+            mState.store(State::STOPPED);
+            mState.notify_all();
+            return;
+        case State::STOPPED:
+        default:
+            assert(false);
+            return;
         }
-        lastProcessResult = mProcess();
     }
 }
@@ -1,5 +1,5 @@
 #pragma once
-#include <condition_variable>
+#include <atomic>
 #include <functional>
 #include <mutex>
 #ifdef WIN32
@@ -8,6 +8,10 @@
 #include <pthread.h>
 #endif
 
+// Runs process() in a loop on its own thread until it returns false or
+// the thread is stopped. The state is a single atomic, the audio thread
+// parks on it with std::atomic::wait while suspended and never takes a
+// lock while running. The mutex only serializes the control methods.
 class ThreadSuspendable
 {
 public:
@@ -19,6 +23,11 @@ public:
     void resume();
     void suspend();
     void stop();
+    // Non-blocking, may be called from process() to park the thread
+    // once the current iteration returns.
+    void requestSuspend();
+    // Changes the scheduling of the running thread, false if the system refuses it.
+    bool setPriority(bool realtime, int priority);
     bool isValid() const;
 
     //do not call this
@@ -26,14 +35,18 @@ public:
 
 private:
     enum class State { SUSPENDED, RUNNING, STOPPED, RESUMING, SUSPENDING, STOPPING };
-    State mState = State::SUSPENDED;
-    std::function<bool()> mProcess = nullptr;
+    bool transition(State to, std::initializer_list<State> ignored);
+    void waitFor(std::initializer_list<State> states);
+    void join();
+
+    alignas(64) std::atomic<State> mState = State::SUSPENDED;
+    alignas(64) std::function<bool()> mProcess = nullptr;
 #ifdef WIN32
     std::thread mThread;
 #else
     pthread_t mThread = 0;
 #endif
+    bool mJoined = false;
 
-    std::mutex mMutex;
-    std::condition_variable mCV;
+    std::mutex mControlMutex;
 };
@@ -0,0 +1,426 @@
+#include "WavFile.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr uint16_t WAVE_FORMAT_PCM = 1;
+constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+constexpr uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+constexpr uint32_t RF64_SIZE_MARKER = 0xFFFFFFFF;
+
+// Offsets of the header written by WavFileWriter.
+constexpr uint64_t JUNK_CHUNK_OFFSET = 12;
+constexpr uint32_t DS64_PAYLOAD_SIZE = 28;
+
+// Tail of the KSDATAFORMAT_SUBTYPE GUIDs, the format tag is in front of it.
+constexpr unsigned char SUBTYPE_GUID_TAIL[14]
+    = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+
+int seekFile(std::FILE *file, uint64_t offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET);
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+}
+
+uint64_t fileSize(std::FILE *file)
+{
+#if defined(_WIN32)
+    if (_fseeki64(file, 0, SEEK_END) != 0)
+        return 0;
+    return static_cast<uint64_t>(_ftelli64(file));
+#else
+    if (fseeko(file, 0, SEEK_END) != 0)
+        return 0;
+    return static_cast<uint64_t>(ftello(file));
+#endif
+}
+
+uint16_t get16(const unsigned char *p)
+{
+    return uint16_t(p[0] | (p[1] << 8));
+}
+
+uint32_t get32(const unsigned char *p)
+{
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+uint64_t get64(const unsigned char *p)
+{
+    return uint64_t(get32(p)) | (uint64_t(get32(p + 4)) << 32);
+}
+
+void put16(std::vector<unsigned char> &out, uint16_t value)
+{
+    out.push_back(value & 0xFF);
+    out.push_back(value >> 8);
+}
+
+void put32(std::vector<unsigned char> &out, uint32_t value)
+{
+    put16(out, value & 0xFFFF);
+    put16(out, value >> 16);
+}
+
+void put64(std::vector<unsigned char> &out, uint64_t value)
+{
+    put32(out, uint32_t(value));
+    put32(out, uint32_t(value >> 32));
+}
+
+void putId(std::vector<unsigned char> &out, const char *id)
+{
+    out.insert(out.end(), id, id + 4);
+}
+
+RtAudioFormat getRtFormat(uint16_t tag, uint16_t bits)
+{
+    if (tag == WAVE_FORMAT_PCM) {
+        switch (bits) {
+        case 16:
+            return RTAUDIO_SINT16;
+        case 24:
+            return RTAUDIO_SINT24;
+        case 32:
+            return RTAUDIO_SINT32;
+        }
+    } else if (tag == WAVE_FORMAT_IEEE_FLOAT) {
+        switch (bits) {
+        case 32:
+            return RTAUDIO_FLOAT32;
+        case 64:
+            return RTAUDIO_FLOAT64;
+        }
+    }
+    return 0;
+}
+} // namespace
+
+bool WavFormat::isSupported(RtAudioFormat format)
+{
+    return format == RTAUDIO_SINT16 || format == RTAUDIO_SINT24 || format == RTAUDIO_SINT32
+           || format == RTAUDIO_FLOAT32 || format == RTAUDIO_FLOAT64;
+}
+
+WavFileReader::~WavFileReader()
+{
+    if (mFile)
+        std::fclose(mFile);
+}
+
+bool WavFileReader::open(const std::string &path)
+{
+    mFile = std::fopen(path.c_str(), "rb");
+    if (!mFile)
+        return fail("cannot open " + path + " for reading");
+    return parseHeader();
+}
+
+bool WavFileReader::parseHeader()
+{
+    uint64_t size = fileSize(mFile);
+    unsigned char riff[12];
+    if (seekFile(mFile, 0) != 0 || std::fread(riff, 1, sizeof(riff), mFile) != sizeof(riff))
+        return fail("file too short");
+    bool rf64 = std::memcmp(riff, "RF64", 4) == 0;
+    if ((!rf64 && std::memcmp(riff, "RIFF", 4) != 0) || std::memcmp(riff + 8, "WAVE", 4) != 0)
+        return fail("not a WAV file");
+
+    uint64_t offset = sizeof(riff);
+    uint64_t ds64DataSize = 0;
+    bool haveFormat = false;
+    while (offset + 8 <= size) {
+        unsigned char header[8];
+        if (seekFile(mFile, offset) != 0 || std::fread(header, 1, sizeof(header), mFile) != sizeof(header))
+            break;
+        uint64_t chunkSize = get32(header + 4);
+        uint64_t payload = offset + 8;
+
+        if (std::memcmp(header, "data", 4) == 0) {
+            if (!haveFormat)
+                return fail("data chunk before fmt chunk");
+            if (rf64 && chunkSize == RF64_SIZE_MARKER)
+                chunkSize = ds64DataSize;
+            // Streaming writers leave the size open, use what is there.
+            if (chunkSize == 0 || chunkSize == RF64_SIZE_MARKER || payload + chunkSize > size)
+                chunkSize = size - payload;
+            mDataOffset = payload;
+            mFrames = chunkSize / mFormat.frameBytes();
+            mPosition = 0;
+            return seekFile(mFile, mDataOffset) == 0;
+        }
+
+        std::vector<unsigned char> data(std::min<uint64_t>(chunkSize, 64));
+        if (std::fread(data.data(), 1, data.size(), mFile) != data.size())
+            return fail("truncated chunk");
+        if (std::memcmp(header, "ds64", 4) == 0) {
+            if (data.size() < 24)
+                return fail("invalid ds64 chunk");
+            ds64DataSize = get64(data.data() + 8);
+        } else if (std::memcmp(header, "fmt ", 4) == 0) {
+            if (data.size() < 16)
+                return fail("invalid fmt chunk");
+            uint16_t tag = get16(data.data());
+            uint16_t bits = get16(data.data() + 14);
+            if (tag == WAVE_FORMAT_EXTENSIBLE && data.size() >= 26)
+                tag = get16(data.data() + 24);
+            mFormat.channels = get16(data.data() + 2);
+            mFormat.sampleRate = get32(data.data() + 4);
+            mFormat.format = getRtFormat(tag, bits);
+            if (mFormat.format == 0 || mFormat.channels == 0)
+                return fail("unsupported sample format");
+            if (get16(data.data() + 12) != mFormat.frameBytes())
+                return fail("unexpected block alignment");
+            haveFormat = true;
+        }
+        offset = payload + chunkSize + (chunkSize & 1);
+    }
+    return fail("no data chunk");
+}
+
+uint64_t WavFileReader::read(char *buffer, uint64_t frames)
+{
+    if (!mFile)
+        return 0;
+    frames = std::min(frames, mFrames - mPosition);
+    size_t read = std::fread(buffer, mFormat.frameBytes(), frames, mFile);
+    mPosition += read;
+    return read;
+}
+
+bool WavFileReader::seek(uint64_t frame)
+{
+    if (!mFile || frame > mFrames)
+        return false;
+    if (seekFile(mFile, mDataOffset + frame * mFormat.frameBytes()) != 0)
+        return false;
+    mPosition = frame;
+    return true;
+}
+
+bool WavFileReader::fail(const std::string &message)
+{
+    mErrorText = message;
+    if (mFile) {
+        std::fclose(mFile);
+        mFile = nullptr;
+    }
+    return false;
+}
+
+WavFileMapping::~WavFileMapping()
+{
+#if defined(_WIN32)
+    if (mMapping)
+        UnmapViewOfFile(mMapping);
+    if (mMappingHandle)
+        CloseHandle(mMappingHandle);
+    if (mFileHandle)
+        CloseHandle(mFileHandle);
+#else
+    if (mMapping)
+        munmap(mMapping, mMappingSize);
+#endif
+}
+
+bool WavFileMapping::open(const std::string &path)
+{
+    uint64_t dataOffset = 0;
+    {
+        WavFileReader reader;
+        if (reader.open(path) == false)
+            return fail(reader.getErrorText());
+        mFormat = reader.format();
+        mFrames = reader.frames();
+        dataOffset = reader.dataOffset();
+    }
+    if (mFrames == 0)
+        return fail("no sample data");
+    uint64_t size = dataOffset + mFrames * mFormat.frameBytes();
+    if (size > SIZE_MAX)
+        return fail("file too large to map");
+    mMappingSize = size_t(size);
+
+    // Mapped private and writable, a callback writing to its input
+    // only modifies its own copy of the page.
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return fail("cannot open " + path + " for reading");
+    mFileHandle = file;
+    mMappingHandle = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (!mMappingHandle)
+        return fail("cannot map " + path);
+    mMapping = MapViewOfFile(mMappingHandle, FILE_MAP_COPY, 0, 0, mMappingSize);
+    if (!mMapping)
+        return fail("cannot map " + path);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return fail("cannot open " + path + " for reading");
+    void *mapping = mmap(nullptr, mMappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        return fail("cannot map " + path);
+    mMapping = mapping;
+    madvise(mMapping, mMappingSize, MADV_SEQUENTIAL);
+#endif
+    mData = static_cast<const char *>(mMapping) + dataOffset;
+    return true;
+}
+
+void WavFileMapping::prefetch(uint64_t frame, uint64_t frames) const
+{
+#if !defined(_WIN32)
+    if (!mData || frame >= mFrames)
+        return;
+    frames = std::min(frames, mFrames - frame);
+    static const uintptr_t pageSize = uintptr_t(sysconf(_SC_PAGESIZE));
+    uintptr_t begin = reinterpret_cast<uintptr_t>(data(frame)) & ~(pageSize - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(data(frame + frames));
+    madvise(reinterpret_cast<void *>(begin), end - begin, MADV_WILLNEED);
+#else
+    // FILE_FLAG_SEQUENTIAL_SCAN already makes the cache manager read ahead.
+    (void) frame;
+    (void) frames;
+#endif
+}
+
+bool WavFileMapping::fail(const std::string &message)
+{
+    mErrorText = message;
+    return false;
+}
+
+WavFileWriter::~WavFileWriter()
+{
+    close();
+}
+
+bool WavFileWriter::open(const std::string &path, const WavFormat &format)
+{
+    if (!WavFormat::isSupported(format.format) || format.channels == 0 || format.channels > 0xFFFF)
+        return fail("unsupported sample format");
+    mFile = std::fopen(path.c_str(), "wb");
+    if (!mFile)
+        return fail("cannot open " + path + " for writing");
+    mFormat = format;
+    mFrames = 0;
+
+    bool isFloat = format.format == RTAUDIO_FLOAT32 || format.format == RTAUDIO_FLOAT64;
+    uint16_t tag = isFloat ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+    uint16_t bits = uint16_t(RtApi::formatBytes(format.format) * 8);
+    bool extensible = format.channels > 2;
+
+    std::vector<unsigned char> header;
+    putId(header, "RIFF");
+    put32(header, 0);
+    putId(header, "WAVE");
+    // Placeholder, becomes the ds64 chunk if the file outgrows RIFF.
+    putId(header, "JUNK");
+    put32(header, DS64_PAYLOAD_SIZE);
+    header.resize(header.size() + DS64_PAYLOAD_SIZE, 0);
+
+    putId(header, "fmt ");
+    put32(header, extensible ? 40 : (isFloat ? 18 : 16));
+    put16(header, extensible ? WAVE_FORMAT_EXTENSIBLE : tag);
+    put16(header, uint16_t(format.channels));
+    put32(header, format.sampleRate);
+    put32(header, format.sampleRate * format.frameBytes());
+    put16(header, uint16_t(format.frameBytes()));
+    put16(header, bits);
+    if (extensible) {
+        put16(header, 22);
+        put16(header, bits);
+        put32(header, 0); // no speaker positions
+        put16(header, tag);
+        header.insert(header.end(), SUBTYPE_GUID_TAIL, SUBTYPE_GUID_TAIL + sizeof(SUBTYPE_GUID_TAIL));
+    } else if (isFloat) {
+        put16(header, 0);
+    }
+    putId(header, "data");
+    put32(header, 0);
+
+    if (std::fwrite(header.data(), 1, header.size(), mFile) != header.size())
+        return fail("error writing header");
+    return true;
+}
+
+bool WavFileWriter::write(const char *buffer, uint64_t frames)
+{
+    if (!mFile)
+        return false;
+    if (std::fwrite(buffer, mFormat.frameBytes(), frames, mFile) != frames)
+        return fail("error writing samples");
+    mFrames += frames;
+    return true;
+}
+
+bool WavFileWriter::close()
+{
+    if (!mFile)
+        return false;
+    uint64_t dataBytes = mFrames * mFormat.frameBytes();
+    if (dataBytes & 1) {
+        // Chunks are padded to an even size.
+        if (std::fputc(0, mFile) == EOF)
+            return fail("error writing samples");
+    }
+    uint64_t dataSizeOffset = fileSize(mFile) - dataBytes - (dataBytes & 1) - 4;
+    uint64_t riffSize = dataSizeOffset + 4 + dataBytes + (dataBytes & 1) - 8;
+
+    std::vector<unsigned char> riff;
+    std::vector<unsigned char> ds64;
+    std::vector<unsigned char> dataSize;
+    if (riffSize <= 0xFFFFFFFE) {
+        putId(riff, "RIFF");
+        put32(riff, uint32_t(riffSize));
+        put32(dataSize, uint32_t(dataBytes));
+    } else {
+        putId(riff, "RF64");
+        put32(riff, RF64_SIZE_MARKER);
+        putId(ds64, "ds64");
+        put32(ds64, DS64_PAYLOAD_SIZE);
+        put64(ds64, riffSize);
+        put64(ds64, dataBytes);
+        put64(ds64, mFrames);
+        put32(ds64, 0); // no table entries
+        put32(dataSize, RF64_SIZE_MARKER);
+    }
+
+    bool success = seekFile(mFile, 0) == 0 && std::fwrite(riff.data(), 1, riff.size(), mFile) == riff.size();
+    if (success && !ds64.empty())
+        success = seekFile(mFile, JUNK_CHUNK_OFFSET) == 0
+                  && std::fwrite(ds64.data(), 1, ds64.size(), mFile) == ds64.size();
+    if (success)
+        success = seekFile(mFile, dataSizeOffset) == 0
+                  && std::fwrite(dataSize.data(), 1, dataSize.size(), mFile) == dataSize.size();
+    success = std::fclose(mFile) == 0 && success;
+    mFile = nullptr;
+    if (!success)
+        mErrorText = "error finalizing header";
+    return success;
+}
+
+bool WavFileWriter::fail(const std::string &message)
+{
+    mErrorText = message;
+    if (mFile) {
+        std::fclose(mFile);
+        mFile = nullptr;
+    }
+    return false;
+}
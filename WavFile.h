@@ -0,0 +1,117 @@
+#pragma once
+#include "RtAudio.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Sample layout of a WAV file, interleaved frames of one RtAudio format.
+struct WavFormat
+{
+    unsigned int channels = 0;
+    unsigned int sampleRate = 0;
+    RtAudioFormat format = 0;
+
+    unsigned int frameBytes() const { return channels * RtApi::formatBytes(format); }
+    // 16, 24 and 32 bit integer or 32 and 64 bit float samples.
+    static bool isSupported(RtAudioFormat format);
+};
+
+// Reads PCM and IEEE float WAV and RF64 files. Sample data is little
+// endian like on every host RtAudio runs on, so frames are returned as is.
+class WavFileReader
+{
+public:
+    WavFileReader() = default;
+    WavFileReader(const WavFileReader &) = delete;
+    WavFileReader &operator=(const WavFileReader &) = delete;
+    ~WavFileReader();
+
+    bool open(const std::string &path);
+    const std::string &getErrorText() const { return mErrorText; }
+
+    const WavFormat &format() const { return mFormat; }
+    uint64_t frames() const { return mFrames; }
+    uint64_t position() const { return mPosition; }
+    uint64_t dataOffset() const { return mDataOffset; }
+
+    // Returns the number of frames read, less than requested at the end of the data.
+    uint64_t read(char *buffer, uint64_t frames);
+    bool seek(uint64_t frame);
+
+private:
+    bool parseHeader();
+    bool fail(const std::string &message);
+
+    std::FILE *mFile = nullptr;
+    WavFormat mFormat;
+    uint64_t mDataOffset = 0;
+    uint64_t mFrames = 0;
+    uint64_t mPosition = 0;
+    std::string mErrorText;
+};
+
+// Maps the sample data of a WAV or RF64 file into memory, so frames can
+// be used in place. The kernel is told the file is read sequentially and
+// prefetch() starts reading ahead of the current position.
+class WavFileMapping
+{
+public:
+    WavFileMapping() = default;
+    WavFileMapping(const WavFileMapping &) = delete;
+    WavFileMapping &operator=(const WavFileMapping &) = delete;
+    ~WavFileMapping();
+
+    bool open(const std::string &path);
+    const std::string &getErrorText() const { return mErrorText; }
+
+    const WavFormat &format() const { return mFormat; }
+    uint64_t frames() const { return mFrames; }
+    // Returns the first byte of frame, valid for frames() - frame frames.
+    const char *data(uint64_t frame) const { return mData + frame * mFormat.frameBytes(); }
+    // Non-blocking hint to read the given range from disk.
+    void prefetch(uint64_t frame, uint64_t frames) const;
+
+private:
+    bool fail(const std::string &message);
+
+    WavFormat mFormat;
+    uint64_t mFrames = 0;
+    const char *mData = nullptr;
+    void *mMapping = nullptr;
+    size_t mMappingSize = 0;
+#if defined(_WIN32)
+    void *mFileHandle = nullptr;
+    void *mMappingHandle = nullptr;
+#endif
+    std::string mErrorText;
+};
+
+// Writes WAV files. The header reserves room for an RF64 ds64 chunk, so
+// files growing beyond 4 GiB are turned into RF64 when they are closed.
+class WavFileWriter
+{
+public:
+    WavFileWriter() = default;
+    WavFileWriter(const WavFileWriter &) = delete;
+    WavFileWriter &operator=(const WavFileWriter &) = delete;
+    ~WavFileWriter();
+
+    bool open(const std::string &path, const WavFormat &format);
+    const std::string &getErrorText() const { return mErrorText; }
+
+    const WavFormat &format() const { return mFormat; }
+    uint64_t frames() const { return mFrames; }
+    bool isOpen() const { return mFile != nullptr; }
+
+    bool write(const char *buffer, uint64_t frames);
+    // Completes the header with the final sizes.
+    bool close();
+
+private:
+    bool fail(const std::string &message);
+
+    std::FILE *mFile = nullptr;
+    WavFormat mFormat;
+    uint64_t mFrames = 0;
+    std::string mErrorText;
+};
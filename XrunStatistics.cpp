@@ -0,0 +1,70 @@
+#include "XrunStatistics.h"
+#include <chrono>
+
+uint64_t XrunStatistics::monotonicNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void XrunStatistics::record(RtAudioStreamStatus type,
+                            uint64_t timestampNs,
+                            unsigned long framesLost,
+                            uint64_t recoveryNs)
+{
+    Totals &totals = mTotals[type == RTAUDIO_INPUT_OVERFLOW ? RtApi::INPUT : RtApi::OUTPUT];
+    totals.count.fetch_add(1, std::memory_order_relaxed);
+    totals.framesLost.fetch_add(framesLost, std::memory_order_relaxed);
+    totals.recoveryNs.fetch_add(recoveryNs, std::memory_order_relaxed);
+    if (recoveryNs > totals.maxRecoveryNs.load(std::memory_order_relaxed))
+        totals.maxRecoveryNs.store(recoveryNs, std::memory_order_relaxed);
+
+    uint64_t index = mEventsWritten.load(std::memory_order_relaxed);
+    Slot &slot = mHistory[index % HISTORY_SIZE];
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.type.store(type, std::memory_order_relaxed);
+    slot.timestampNs.store(timestampNs, std::memory_order_relaxed);
+    slot.framesLost.store(framesLost, std::memory_order_relaxed);
+    slot.recoveryNs.store(recoveryNs, std::memory_order_relaxed);
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    mEventsWritten.store(index + 1, std::memory_order_release);
+}
+
+RtAudioXrunStatistics XrunStatistics::snapshot() const
+{
+    RtAudioXrunStatistics stats{};
+    const Totals &out = mTotals[RtApi::OUTPUT];
+    const Totals &in = mTotals[RtApi::INPUT];
+    stats.outputUnderflows = out.count.load(std::memory_order_relaxed);
+    stats.outputFramesLost = out.framesLost.load(std::memory_order_relaxed);
+    stats.outputRecoveryNs = out.recoveryNs.load(std::memory_order_relaxed);
+    stats.outputMaxRecoveryNs = out.maxRecoveryNs.load(std::memory_order_relaxed);
+    stats.inputOverflows = in.count.load(std::memory_order_relaxed);
+    stats.inputFramesLost = in.framesLost.load(std::memory_order_relaxed);
+    stats.inputRecoveryNs = in.recoveryNs.load(std::memory_order_relaxed);
+    stats.inputMaxRecoveryNs = in.maxRecoveryNs.load(std::memory_order_relaxed);
+
+    uint64_t written = mEventsWritten.load(std::memory_order_acquire);
+    uint64_t first = written > HISTORY_SIZE ? written - HISTORY_SIZE : 0;
+    stats.recentEvents.reserve(written - first);
+    for (uint64_t i = first; i < written; i++) {
+        const Slot &slot = mHistory[i % HISTORY_SIZE];
+        // Event number i completes its slot with sequence 2 * (round + 1).
+        uint64_t sequenceBefore = slot.sequence.load(std::memory_order_acquire);
+        if (sequenceBefore != 2 * (i / HISTORY_SIZE + 1))
+            continue; // reused by a newer event
+        RtAudioXrunEvent event{};
+        event.type = static_cast<RtAudioStreamStatus>(slot.type.load(std::memory_order_relaxed));
+        event.timestampNs = slot.timestampNs.load(std::memory_order_relaxed);
+        event.framesLost = slot.framesLost.load(std::memory_order_relaxed);
+        event.recoveryNs = slot.recoveryNs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequenceBefore)
+            continue; // overwritten while copying
+        stats.recentEvents.push_back(event);
+    }
+    return stats;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "RtAudio.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free xrun bookkeeping. record() is called from the audio thread
+// only (single writer), snapshot() may be called from any thread.
+class XrunStatistics
+{
+public:
+    static constexpr size_t HISTORY_SIZE = 32;
+
+    XrunStatistics() = default;
+    XrunStatistics(const XrunStatistics &) = delete;
+    XrunStatistics &operator=(const XrunStatistics &) = delete;
+
+    static uint64_t monotonicNowNs();
+
+    void record(RtAudioStreamStatus type,
+                uint64_t timestampNs,
+                unsigned long framesLost,
+                uint64_t recoveryNs);
+    RtAudioXrunStatistics snapshot() const;
+
+private:
+    struct Totals
+    {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> framesLost{0};
+        std::atomic<uint64_t> recoveryNs{0};
+        std::atomic<uint64_t> maxRecoveryNs{0};
+    };
+
+    // Every slot is guarded by a sequence number: odd while the writer
+    // updates it, even once the event is complete.
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<uint64_t> type{0};
+        std::atomic<uint64_t> timestampNs{0};
+        std::atomic<uint64_t> framesLost{0};
+        std::atomic<uint64_t> recoveryNs{0};
+    };
+
+    Totals mTotals[2]; // Playback and record, respectively.
+    std::array<Slot, HISTORY_SIZE> mHistory;
+    std::atomic<uint64_t> mEventsWritten{0};
+};
@@ -1,12 +1,29 @@
 #include "RtApiAlsaStream.h"
+#include "RtApiAlsaStreamFactory.h"
+#include "LatencyController.h"
+#include "XrunStatistics.h"
+#include <cstring>
 
 namespace {
-void *alsaCallbackHandler(void *ptr)
+// Estimates how many frames were lost since the device entered the xrun
+// state, the same way aplay reports the length of an xrun.
+unsigned long getXrunFramesLost(snd_pcm_t *handle, unsigned int sampleRate)
 {
-    CallbackInfo *info = reinterpret_cast<CallbackInfo *>(ptr);
-    RtApiAlsaStream *object = reinterpret_cast<RtApiAlsaStream *>(info->object);
-    object->callbackEvent();
-    pthread_exit(NULL);
+    snd_pcm_status_t *status = nullptr;
+    snd_pcm_status_alloca(&status);
+    if (snd_pcm_status(handle, status) < 0)
+        return 0;
+    if (snd_pcm_status_get_state(status) != SND_PCM_STATE_XRUN)
+        return 0;
+    snd_htimestamp_t now{};
+    snd_htimestamp_t trigger{};
+    snd_pcm_status_get_htstamp(status, &now);
+    snd_pcm_status_get_trigger_htstamp(status, &trigger);
+    int64_t diffNs = (int64_t(now.tv_sec) - int64_t(trigger.tv_sec)) * 1000000000
+                     + (int64_t(now.tv_nsec) - int64_t(trigger.tv_nsec));
+    if (diffNs <= 0)
+        return 0;
+    return static_cast<unsigned long>(diffNs * sampleRate / 1000000000);
 }
 } // namespace
 
@@ -16,71 +33,163 @@ RtApiAlsaStream::RtApiAlsaStream(RtApi::RtApiStream stream,
     : RtApiStreamClass(std::move(stream))
     , mHandlePlayback(std::move(phandlePlayback))
     , mHandleCapture(std::move(phandleCapture))
+    , mThread([this]() { return threadMethod(); },
+              stream_.callbackInfo.doRealtime,
+              stream_.callbackInfo.priority)
 {
-    setupThread();
+    if (mThread.isValid() == false)
+        error(RTAUDIO_THREAD_ERROR, "RtApiAlsa::error creating callback thread!");
+    setupLatencyController();
 }
 
 RtApiAlsaStream::~RtApiAlsaStream()
 {
-    {
-        std::unique_lock g(mThreadMutex);
-        mRunningFlag = true;
-        mStopFlag = true;
-        mThreadCV.notify_one();
-    }
-
-    if (stream_.callbackInfo.thread) {
-        pthread_join(stream_.callbackInfo.thread, NULL);
-    }
+    mThread.stop();
 }
 
 RtAudioErrorType RtApiAlsaStream::startStream()
 {
-    {
-        std::unique_lock g(mThreadMutex);
-        if (stream_.state != RtApi::STREAM_STOPPED) {
-            return RTAUDIO_SYSTEM_ERROR;
-        }
-        mRunningFlag = true;
-        mThreadCV.notify_one();
+    if (stream_.state == RtApi::STREAM_WARM) {
+        // The device is already running, the next period goes to the callback.
+        mCallbackEnabled = true;
+        stream_.state = RtApi::STREAM_RUNNING;
+        return RTAUDIO_NO_ERROR;
+    }
+    if (stream_.state != RtApi::STREAM_STOPPED) {
+        return RTAUDIO_SYSTEM_ERROR;
     }
+    mCallbackEnabled = true;
     stream_.state = RtApi::STREAM_RUNNING;
+    mThread.resume();
     return RTAUDIO_NO_ERROR;
 }
 
 RtAudioErrorType RtApiAlsaStream::stopStream()
 {
-    {
-        std::unique_lock g(mThreadMutex);
-        if (stream_.state != RtApi::STREAM_RUNNING) {
-            return RTAUDIO_SYSTEM_ERROR;
-        }
-        mRunningFlag = false;
-        mThreadPausedCV.wait(g);
+    if (stream_.state == RtApi::STREAM_PAUSED) {
+        resetHandles();
+        stream_.state = RtApi::STREAM_STOPPED;
+        return RTAUDIO_NO_ERROR;
     }
+    if (stream_.state != RtApi::STREAM_RUNNING && stream_.state != RtApi::STREAM_WARM) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    mThread.suspend();
+    // Left running, the devices would be in an xrun by the next start.
+    resetHandles();
     stream_.state = RtApi::STREAM_STOPPED;
     return RTAUDIO_NO_ERROR;
 }
 
-void RtApiAlsaStream::callbackEvent()
+void RtApiAlsaStream::resetHandles()
 {
-    while (true) {
-        {
-            std::unique_lock g(mThreadMutex);
-            while (mRunningFlag == false) {
-                mThreadPausedCV.notify_one();
-                mThreadCV.wait(g);
-            }
-            if (mStopFlag)
-                return;
-        }
-        if (processAudio() == false) {
-            stream_.state = RtApi::STREAM_ERROR;
-            return;
+    for (snd_pcm_t *handle : {mHandlePlayback.handle(), mHandleCapture.handle()}) {
+        if (handle) {
+            snd_pcm_drop(handle);
+            snd_pcm_prepare(handle);
         }
     }
 }
 
+RtAudioErrorType RtApiAlsaStream::warmStream()
+{
+    if (stream_.state == RtApi::STREAM_RUNNING) {
+        mCallbackEnabled = false;
+        stream_.state = RtApi::STREAM_WARM;
+        return RTAUDIO_NO_ERROR;
+    }
+    if (stream_.state != RtApi::STREAM_STOPPED) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    mCallbackEnabled = false;
+    stream_.state = RtApi::STREAM_WARM;
+    mThread.resume();
+    return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiAlsaStream::pauseStream()
+{
+    if (stream_.state != RtApi::STREAM_RUNNING && stream_.state != RtApi::STREAM_WARM) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    if (canPause() == false) {
+        return error(RTAUDIO_WARNING, "RtApiAlsaStream::pauseStream: the device does not support pausing.");
+    }
+    mThread.suspend();
+    mStateBeforePause = stream_.state;
+    if (setPaused(true) == false) {
+        stream_.state = RtApi::STREAM_STOPPED;
+        return error(RTAUDIO_DRIVER_ERROR, "RtApiAlsaStream::pauseStream: error pausing the device.");
+    }
+    stream_.state = RtApi::STREAM_PAUSED;
+    return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiAlsaStream::resumeStream()
+{
+    if (stream_.state != RtApi::STREAM_PAUSED) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    if (setPaused(false) == false) {
+        return error(RTAUDIO_DRIVER_ERROR, "RtApiAlsaStream::resumeStream: error resuming the device.");
+    }
+    stream_.state = mStateBeforePause;
+    mThread.resume();
+    return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiAlsaStream::reconfigure(unsigned int bufferSize, unsigned int sampleRate)
+{
+    if (stream_.state != RtApi::STREAM_STOPPED && stream_.state != RtApi::STREAM_PAUSED) {
+        return error(RTAUDIO_INVALID_USE, "RtApiAlsaStream::reconfigure: the stream must be stopped or paused.");
+    }
+    unsigned int playbackSize = bufferSize;
+    unsigned int captureSize = bufferSize;
+    snd_pcm_t *playback = mHandlePlayback.handle();
+    snd_pcm_t *capture = mHandleCapture.handle();
+    // Both devices are checked before either is changed.
+    bool success = true;
+    if (playback)
+        success = RtApiAlsaStreamFactory::reconfigureHandle(playback, sampleRate, playbackSize, false);
+    if (capture && success)
+        success = RtApiAlsaStreamFactory::reconfigureHandle(capture, sampleRate, captureSize, false);
+    if (success && playback && capture && playbackSize != captureSize) {
+        return error(RTAUDIO_SYSTEM_ERROR, "RtApiAlsaStream::reconfigure: input and output buffer size mismatch.");
+    }
+    if (success && playback)
+        success = RtApiAlsaStreamFactory::reconfigureHandle(playback, sampleRate, playbackSize);
+    if (success && capture) {
+        success = RtApiAlsaStreamFactory::reconfigureHandle(capture, sampleRate, captureSize);
+        // Playback goes back to the setup the stream still describes.
+        unsigned int previousSize = stream_.bufferSize;
+        if (success == false && playback
+            && RtApiAlsaStreamFactory::reconfigureHandle(playback, stream_.sampleRate, previousSize) == false)
+            stream_.errorState = true;
+    }
+    if (success == false) {
+        errorStream_ << "RtApiAlsaStream::reconfigure: error setting " << bufferSize << " frames at "
+                     << sampleRate << " Hz on device (" << stream_.deviceId << ").";
+        return error(RTAUDIO_SYSTEM_ERROR, errorStream_.str());
+    }
+    if (resizeStreamBuffers(playback ? playbackSize : captureSize, sampleRate) == false) {
+        return RTAUDIO_MEMORY_ERROR;
+    }
+    stream_.latency[RtApi::OUTPUT] = 0;
+    stream_.latency[RtApi::INPUT] = 0;
+    setupLatencyController();
+    return RTAUDIO_NO_ERROR;
+}
+
+bool RtApiAlsaStream::threadMethod()
+{
+    if (processAudio() == false) {
+        stream_.errorState = true;
+        stream_.state = RtApi::STREAM_ERROR;
+        return false;
+    }
+    return true;
+}
+
 bool RtApiAlsaStream::processAudio()
 {
     RtAudioStreamStatus status = 0;
@@ -95,6 +204,7 @@ bool RtApiAlsaStream::processAudio()
     }
     RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
     double streamTime = getStreamTime();
+    bool callbackEnabled = mCallbackEnabled;
 
     int result;
     char *buffer;
@@ -109,12 +219,36 @@ bool RtApiAlsaStream::processAudio()
         }
     }
 
-    callback(stream_.userBuffer[RtApi::OUTPUT].get(),
-             stream_.userBuffer[RtApi::INPUT].get(),
-             stream_.bufferSize,
-             streamTime,
-             status,
-             stream_.callbackInfo.userData);
+    if (callbackEnabled == false) {
+        // Warm standby: keep the device fed with silence and drop the input.
+        if (stream_.mode == RtApi::OUTPUT || stream_.mode == RtApi::DUPLEX) {
+            memset(stream_.userBuffer[RtApi::OUTPUT].get(),
+                   0,
+                   stream_.nUserChannels[RtApi::OUTPUT] * stream_.bufferSize
+                       * RtApi::formatBytes(stream_.userFormat));
+            return processOutput();
+        }
+        return true;
+    }
+
+    uint64_t callbackStart = mLatencyController ? XrunStatistics::monotonicNowNs() : 0;
+    int callbackResult = callback(stream_.userBuffer[RtApi::OUTPUT].get(),
+                                  stream_.userBuffer[RtApi::INPUT].get(),
+                                  stream_.bufferSize,
+                                  streamTime,
+                                  status,
+                                  stream_.callbackInfo.userData);
+    if (mLatencyController) {
+        uint64_t callbackNs = XrunStatistics::monotonicNowNs() - callbackStart;
+        uint64_t periodNs = uint64_t(stream_.bufferSize) * 1000000000 / stream_.sampleRate;
+        if (mLatencyController->onPeriod(callbackNs, periodNs))
+            applyLatencyTarget();
+    }
+
+    if (callbackResult == 2) {
+        finishStream(false);
+        return true;
+    }
 
     if (stream_.mode == RtApi::OUTPUT || stream_.mode == RtApi::DUPLEX) {
         if (processOutput() == false) {
@@ -123,6 +257,8 @@ bool RtApiAlsaStream::processAudio()
     }
 
     tickStreamTime();
+    if (callbackResult == 1)
+        finishStream(true);
     return true;
 }
 
@@ -165,11 +301,7 @@ bool RtApiAlsaStream::processInput()
         if (result <= 0) {
             // Either an error or overrun occurred.
             if (result == -EPIPE) {
-                snd_pcm_state_t state = snd_pcm_state(handle);
-                if (state == SND_PCM_STATE_XRUN) {
-                    mXrunInput = true;
-                    snd_pcm_prepare(handle);
-                }
+                recoverXrun(handle, RtApi::INPUT);
                 continue;
             } else if (result == -EAGAIN) {
                 uint64_t bufsize64 = stream_.bufferSize - readSamples;
@@ -227,6 +359,11 @@ bool RtApiAlsaStream::processOutput()
     if (stream_.doByteSwap[RtApi::OUTPUT])
         RtApi::byteSwapBuffer(buffer, stream_.bufferSize * channels, format);
 
+    // In adaptive mode only write once the queued output dropped to the
+    // target, see applyLatencyTarget(). Xruns are handled by the write.
+    if (mLatencyController)
+        snd_pcm_wait(handle, 1000);
+
     // Write samples to device in interleaved/non-interleaved format.
     int samplesPlayed = 0;
 
@@ -245,11 +382,7 @@ bool RtApiAlsaStream::processOutput()
         if (result <= 0) {
             // Either an error or underrun occurred.
             if (result == -EPIPE) {
-                snd_pcm_state_t state = snd_pcm_state(handle);
-                if (state == SND_PCM_STATE_XRUN) {
-                    mXrunOutput = true;
-                    snd_pcm_prepare(handle);
-                }
+                recoverXrun(handle, RtApi::OUTPUT);
                 continue;
             } else if (result == -EAGAIN) {
                 uint64_t bufsize64 = stream_.bufferSize - samplesPlayed;
@@ -265,6 +398,124 @@ bool RtApiAlsaStream::processOutput()
     return true;
 }
 
+void RtApiAlsaStream::recoverXrun(snd_pcm_t *handle, RtApi::StreamMode mode)
+{
+    snd_pcm_state_t state = snd_pcm_state(handle);
+    if (state != SND_PCM_STATE_XRUN)
+        return;
+    uint64_t detected = XrunStatistics::monotonicNowNs();
+    unsigned long framesLost = getXrunFramesLost(handle, stream_.sampleRate);
+    snd_pcm_prepare(handle);
+    uint64_t recovered = XrunStatistics::monotonicNowNs();
+
+    if (mode == RtApi::INPUT) {
+        mXrunInput = true;
+        registerXrun(RTAUDIO_INPUT_OVERFLOW, detected, framesLost, recovered - detected);
+    } else {
+        mXrunOutput = true;
+        registerXrun(RTAUDIO_OUTPUT_UNDERFLOW, detected, framesLost, recovered - detected);
+        if (mLatencyController && mLatencyController->onXrun())
+            applyLatencyTarget();
+    }
+}
+
+void RtApiAlsaStream::setupLatencyController()
+{
+    mLatencyController.reset();
+    snd_pcm_t *handle = mHandlePlayback.handle();
+    if (!stream_.adaptiveLatency || !handle || stream_.bufferSize == 0)
+        return;
+    snd_pcm_uframes_t periodFrames = 0;
+    if (snd_pcm_get_params(handle, &mHwBufferFrames, &periodFrames) < 0)
+        return;
+    unsigned int hwPeriods = mHwBufferFrames / stream_.bufferSize;
+    if (hwPeriods < 2)
+        return;
+    mLatencyController = std::make_unique<LatencyController>(2,
+                                                             hwPeriods,
+                                                             stream_.sampleRate / stream_.bufferSize);
+    applyLatencyTarget();
+}
+
+void RtApiAlsaStream::applyLatencyTarget()
+{
+    // snd_pcm_wait() returns once avail_min frames are free, so the device
+    // holds at most periods() periods right after the next write.
+    snd_pcm_t *handle = mHandlePlayback.handle();
+    snd_pcm_uframes_t queued = snd_pcm_uframes_t(mLatencyController->periods() - 1) * stream_.bufferSize;
+    snd_pcm_sw_params_t *swParams = nullptr;
+    snd_pcm_sw_params_alloca(&swParams);
+    if (snd_pcm_sw_params_current(handle, swParams) < 0)
+        return;
+    snd_pcm_sw_params_set_avail_min(handle, swParams, mHwBufferFrames - queued);
+    if (snd_pcm_sw_params(handle, swParams) < 0)
+        return;
+    notifyLatencyChanged(mLatencyController->periods() * stream_.bufferSize);
+}
+
+void RtApiAlsaStream::finishStream(bool drain)
+{
+    // Runs on the stream thread, so stopStream() never has to wait for
+    // the device to play out.
+    bool success = true;
+    snd_pcm_t *playback = mHandlePlayback.handle();
+    snd_pcm_t *capture = mHandleCapture.handle();
+    if (playback) {
+        if (drain)
+            success = drainPlayback(playback);
+        else
+            success = snd_pcm_drop(playback) == 0;
+        success = snd_pcm_prepare(playback) == 0 && success;
+    }
+    if (capture) {
+        snd_pcm_drop(capture);
+        success = snd_pcm_prepare(capture) == 0 && success;
+    }
+    mThread.requestSuspend();
+    stream_.state = RtApi::STREAM_STOPPED;
+    notifyStreamFinished(success ? RTAUDIO_NO_ERROR : RTAUDIO_DRIVER_ERROR);
+}
+
+bool RtApiAlsaStream::canPause() const
+{
+    for (snd_pcm_t *handle : {mHandlePlayback.handle(), mHandleCapture.handle()}) {
+        if (!handle)
+            continue;
+        snd_pcm_hw_params_t *hwParams = nullptr;
+        snd_pcm_hw_params_alloca(&hwParams);
+        if (snd_pcm_hw_params_current(handle, hwParams) < 0)
+            return false;
+        if (snd_pcm_hw_params_can_pause(hwParams) == 0)
+            return false;
+    }
+    return true;
+}
+
+bool RtApiAlsaStream::setPaused(bool pause)
+{
+    // Linked duplex handles change state together, so only touch the
+    // ones that did not follow yet.
+    snd_pcm_state_t from = pause ? SND_PCM_STATE_RUNNING : SND_PCM_STATE_PAUSED;
+    for (snd_pcm_t *handle : {mHandlePlayback.handle(), mHandleCapture.handle()}) {
+        if (!handle || snd_pcm_state(handle) != from)
+            continue;
+        if (snd_pcm_pause(handle, pause ? 1 : 0) < 0)
+            return false;
+    }
+    return true;
+}
+
+bool RtApiAlsaStream::drainPlayback(snd_pcm_t *handle)
+{
+    int result = snd_pcm_drain(handle);
+    // Non-blocking handles return -EAGAIN and keep draining in the background.
+    while (result == -EAGAIN && snd_pcm_state(handle) == SND_PCM_STATE_DRAINING) {
+        uint64_t bufsize64 = stream_.bufferSize;
+        usleep(bufsize64 * (1000000 / 2) / stream_.sampleRate);
+    }
+    return result == 0 || result == -EAGAIN;
+}
+
 void RtApiAlsaStream::updateStreamLatency(snd_pcm_t *handle, RtApi::StreamMode mode)
 {
     snd_pcm_sframes_t frames = 0;
@@ -272,63 +523,3 @@ void RtApiAlsaStream::updateStreamLatency(snd_pcm_t *handle, RtApi::StreamMode m
     if (result == 0 && frames > 0)
         stream_.latency[mode] = frames;
 }
-
-bool RtApiAlsaStream::setupThread()
-{
-    int result = 0;
-    // Setup callback thread.
-    stream_.callbackInfo.object = (void *) this;
-
-    // Set the thread attributes for joinable and realtime scheduling
-    // priority (optional).  The higher priority will only take affect
-    // if the program is run as root or suid. Note, under Linux
-    // processes with CAP_SYS_NICE privilege, a user can change
-    // scheduling policy and priority (thus need not be root). See
-    // POSIX "capabilities".
-    pthread_attr_t attr{};
-    pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-#ifdef SCHED_RR // Undefined with some OSes (e.g. NetBSD 1.6.x with GNU Pthread)
-    if (stream_.callbackInfo.doRealtime) {
-        struct sched_param param;
-        int priority = stream_.callbackInfo.priority;
-        int min = sched_get_priority_min(SCHED_RR);
-        int max = sched_get_priority_max(SCHED_RR);
-        if (priority < min)
-            priority = min;
-        else if (priority > max)
-            priority = max;
-        param.sched_priority = priority;
-
-        // Set the policy BEFORE the priority. Otherwise it fails.
-        pthread_attr_setschedpolicy(&attr, SCHED_RR);
-        pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
-        // This is definitely required. Otherwise it fails.
-        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
-        pthread_attr_setschedparam(&attr, &param);
-    } else
-        pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
-#else
-    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
-#endif
-
-    stream_.callbackInfo.isRunning = true;
-    result = pthread_create(&stream_.callbackInfo.thread,
-                            &attr,
-                            alsaCallbackHandler,
-                            &stream_.callbackInfo);
-    pthread_attr_destroy(&attr);
-    if (result) {
-        // Failed. Try instead with default attributes.
-        result = pthread_create(&stream_.callbackInfo.thread,
-                                NULL,
-                                alsaCallbackHandler,
-                                &stream_.callbackInfo);
-        if (result) {
-            stream_.callbackInfo.isRunning = false;
-            error(RTAUDIO_THREAD_ERROR, "RtApiAlsa::error creating callback thread!");
-            return RtApi::FAILURE;
-        }
-    }
-    return RtApi::SUCCESS;
-}
@@ -2,9 +2,11 @@
 
 #include "RtAudio.h"
 #include "SndPcmHandle.h"
+#include "ThreadSuspendable.h"
 #include "alsa/asoundlib.h"
 #include <atomic>
-#include <condition_variable>
+
+class LatencyController;
 
 class RtApiAlsaStream : public RtApiStreamClass
 {
@@ -16,30 +18,39 @@ public:
     RtAudio::Api getCurrentApi(void) override { return RtAudio::LINUX_ALSA; }
     RtAudioErrorType startStream(void) override;
     RtAudioErrorType stopStream(void) override;
-
-    // This function is intended for internal use only.  It must be
-    // public because it is called by the internal callback handler,
-    // which is not a member of RtAudio.  External use of this function
-    // will most likely produce highly undesirable results!
-    void callbackEvent(void);
+    RtAudioErrorType warmStream(void) override;
+    RtAudioErrorType pauseStream(void) override;
+    RtAudioErrorType resumeStream(void) override;
+    RtAudioErrorType reconfigure(unsigned int bufferSize, unsigned int sampleRate) override;
 
 private:
+    bool threadMethod();
     bool processAudio();
     bool processInput();
     bool processOutput();
+    void recoverXrun(snd_pcm_t *handle, RtApi::StreamMode mode);
+    void finishStream(bool drain);
+    bool canPause() const;
+    void setupLatencyController();
+    void applyLatencyTarget();
+    bool setPaused(bool pause);
+    // Drops pending data and prepares the devices for the next start.
+    void resetHandles();
+    bool drainPlayback(snd_pcm_t *handle);
     void updateStreamLatency(snd_pcm_t *handle, RtApi::StreamMode mode);
 
-    bool setupThread();
-    std::atomic_bool mStopFlag = false;
-    std::atomic_bool mRunningFlag = false;
-
-    std::mutex mThreadMutex;
-    std::condition_variable mThreadCV;
-    std::condition_variable mThreadPausedCV;
-
     SndPcmHandle mHandlePlayback;
     SndPcmHandle mHandleCapture;
 
     bool mXrunOutput = false;
     bool mXrunInput = false;
+
+    std::unique_ptr<LatencyController> mLatencyController;
+    snd_pcm_uframes_t mHwBufferFrames = 0;
+
+    std::atomic_bool mCallbackEnabled = false;
+    RtApi::StreamState mStateBeforePause = RtApi::STREAM_STOPPED;
+
+    // Declared last, so the thread is stopped before the handles close.
+    ThreadSuspendable mThread;
 };
@@ -86,6 +86,8 @@ bool setupBufferPeriod(RtAudio::StreamOptions* options, unsigned int& bufferSize
     if ( options && options->flags & RTAUDIO_MINIMIZE_LATENCY ) periods = 2;
     if ( options && options->numberOfBuffers > 0 ) periods = options->numberOfBuffers;
     if ( periods < 2 ) periods = 4; // a fairly safe default value
+    // Adaptive latency needs room to grow the queued output.
+    if ( options && options->flags & RTAUDIO_ADAPTIVE_LATENCY ) periods = std::max( periods, 8u );
     result = snd_pcm_hw_params_set_periods_near( phandle, hw_params, &periods, &dir );
     if ( result < 0 ) {
         return false;
@@ -282,6 +284,61 @@ std::shared_ptr<RtApiStreamClass> RtApiAlsaStreamFactory::createStream(CreateStr
                                                              : SndPcmHandle());
 }
 
+bool RtApiAlsaStreamFactory::reconfigureHandle(snd_pcm_t *phandle,
+                                               unsigned int sampleRate,
+                                               unsigned int &bufferSize,
+                                               bool apply)
+{
+    snd_pcm_hw_params_t *current = nullptr;
+    snd_pcm_hw_params_alloca(&current);
+    if (snd_pcm_hw_params_current(phandle, current) < 0)
+        return false;
+    snd_pcm_access_t access{};
+    snd_pcm_format_t format{};
+    unsigned int channels = 0;
+    unsigned int periods = 0;
+    int dir = 0;
+    if (snd_pcm_hw_params_get_access(current, &access) < 0
+        || snd_pcm_hw_params_get_format(current, &format) < 0
+        || snd_pcm_hw_params_get_channels(current, &channels) < 0
+        || snd_pcm_hw_params_get_periods(current, &periods, &dir) < 0)
+        return false;
+
+    // The new setup is refined on a scratch configuration, the device is
+    // only touched once it is known to be accepted.
+    snd_pcm_hw_params_t *hw_params = nullptr;
+    snd_pcm_hw_params_alloca(&hw_params);
+    if (snd_pcm_hw_params_any(phandle, hw_params) < 0)
+        return false;
+    if (snd_pcm_hw_params_set_access(phandle, hw_params, access) < 0
+        || snd_pcm_hw_params_set_format(phandle, hw_params, format) < 0
+        || snd_pcm_hw_params_set_rate(phandle, hw_params, sampleRate, 0) < 0
+        || snd_pcm_hw_params_set_channels(phandle, hw_params, channels) < 0)
+        return false;
+
+    snd_pcm_uframes_t periodSize = bufferSize;
+    if (snd_pcm_hw_params_set_period_size_near(phandle, hw_params, &periodSize, &dir) < 0
+        || snd_pcm_hw_params_set_periods_near(phandle, hw_params, &periods, &dir) < 0)
+        return false;
+    if (apply == false) {
+        bufferSize = periodSize;
+        return true;
+    }
+
+    // hw params can only be installed while the device is not running.
+    // Installing the hardware configuration also prepares the device.
+    snd_pcm_drop(phandle);
+    if (snd_pcm_hw_params(phandle, hw_params) < 0 || setSwParams(phandle, periodSize, nullptr) < 0) {
+        snd_pcm_uframes_t previousPeriod = 0;
+        if (snd_pcm_hw_params_get_period_size(current, &previousPeriod, &dir) >= 0
+            && snd_pcm_hw_params(phandle, current) >= 0)
+            setSwParams(phandle, previousPeriod, nullptr);
+        return false;
+    }
+    bufferSize = periodSize;
+    return true;
+}
+
 std::optional<RtApiAlsaStreamFactory::streamOpenData>
 RtApiAlsaStreamFactory::createStreamDirectionHandle(snd_pcm_stream_t stream,
                                                     CreateStreamParams params,
@@ -11,6 +11,15 @@ public:
     RtAudio::Api getCurrentApi(void) override { return RtAudio::LINUX_ALSA; }
     std::shared_ptr<RtApiStreamClass> createStream(CreateStreamParams params) override;
 
+    // Installs a new sample rate and period size on an open handle, keeping
+    // its access, format, channels and period count. bufferSize is updated
+    // to the period size the device accepts. Without apply the handle is
+    // left untouched, a failed installation restores the previous setup.
+    static bool reconfigureHandle(snd_pcm_t *phandle,
+                                  unsigned int sampleRate,
+                                  unsigned int &bufferSize,
+                                  bool apply = true);
+
     struct streamOpenData
     {
         SndPcmHandle han;
@@ -0,0 +1,83 @@
+#include "BufferedWavWriter.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// Seconds of audio the ring holds and the fraction of it written at once.
+constexpr unsigned int RING_SECONDS = 2;
+constexpr unsigned int BATCHES_PER_RING = 8;
+} // namespace
+
+BufferedWavWriter::~BufferedWavWriter()
+{
+    close();
+}
+
+bool BufferedWavWriter::open(const std::string &path, const WavFormat &format, unsigned int bufferFrames)
+{
+    if (mFile.open(path, format) == false)
+        return false;
+    size_t frames = std::max<size_t>(size_t(format.sampleRate) * RING_SECONDS, size_t(bufferFrames) * 4);
+    mRing.resize(frames, format.frameBytes());
+    mBatchFrames = std::max<size_t>(mRing.capacity() / BATCHES_PER_RING, bufferFrames);
+    mThread = std::thread(&BufferedWavWriter::writerThread, this);
+    return true;
+}
+
+bool BufferedWavWriter::push(const char *frames, unsigned int count)
+{
+    if (mRing.write(frames, count) == false) {
+        mDroppedFrames.fetch_add(count, std::memory_order_relaxed);
+        return false;
+    }
+    mPushed += count;
+    if (mPushed - mNotified >= mBatchFrames) {
+        mNotified = mPushed;
+        wakeWriter();
+    }
+    return true;
+}
+
+void BufferedWavWriter::flush()
+{
+    mNotified = mPushed;
+    wakeWriter();
+}
+
+bool BufferedWavWriter::close()
+{
+    if (mThread.joinable()) {
+        mStop = true;
+        wakeWriter();
+        mThread.join();
+    }
+    if (mFile.isOpen() == false)
+        return mFailed == false;
+    return mFile.close() && mFailed == false;
+}
+
+void BufferedWavWriter::wakeWriter()
+{
+    mWakeups.fetch_add(1, std::memory_order_release);
+    mWakeups.notify_one();
+}
+
+void BufferedWavWriter::writerThread()
+{
+    while (true) {
+        // Read before checking for work, a wake-up in between makes wait() return at once.
+        uint32_t wakeups = mWakeups.load(std::memory_order_acquire);
+        AudioRingBuffer<char>::View ready = mRing.readView();
+        if (ready.frames() == 0) {
+            if (mStop)
+                return;
+            mWakeups.wait(wakeups, std::memory_order_acquire);
+            continue;
+        }
+        for (const AudioRingBuffer<char>::Span &span : {ready.first, ready.second}) {
+            if (span.frames > 0 && mFailed == false && mFile.write(span.data, span.frames) == false)
+                mFailed = true;
+        }
+        mRing.commitRead(ready.frames());
+    }
+}
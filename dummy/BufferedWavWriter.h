@@ -0,0 +1,50 @@
+#pragma once
+#include "AudioRingBuffer.h"
+#include "WavFile.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Writes a WAV file from a writer thread. The audio thread copies each
+// period into a preallocated ring and only wakes the writer once a batch
+// has been collected, so it never blocks on the disk. Periods that do not
+// fit because the disk falls behind are dropped and counted.
+class BufferedWavWriter
+{
+public:
+    BufferedWavWriter() = default;
+    BufferedWavWriter(const BufferedWavWriter &) = delete;
+    BufferedWavWriter &operator=(const BufferedWavWriter &) = delete;
+    ~BufferedWavWriter();
+
+    bool open(const std::string &path, const WavFormat &format, unsigned int bufferFrames);
+    const std::string &getErrorText() const { return mFile.getErrorText(); }
+
+    // Audio thread only.
+    bool push(const char *frames, unsigned int count);
+    // Wakes the writer for whatever was pushed so far.
+    void flush();
+    // Writes the remaining frames and completes the file.
+    bool close();
+
+    uint64_t droppedFrames() const { return mDroppedFrames.load(std::memory_order_relaxed); }
+
+private:
+    void wakeWriter();
+    void writerThread();
+
+    WavFileWriter mFile;
+    // One ring sample per byte, a frame of the file per ring frame.
+    AudioRingBuffer<char> mRing;
+    size_t mBatchFrames = 0;
+
+    uint64_t mPushed = 0; // Frames pushed by the audio thread.
+    uint64_t mNotified = 0;
+    std::atomic<uint32_t> mWakeups{0};
+    std::atomic<uint64_t> mDroppedFrames{0};
+    std::atomic_bool mStop = false;
+    bool mFailed = false;
+    std::thread mThread;
+};
@@ -0,0 +1,63 @@
+#include "DummyDevices.h"
+#include <cstdlib>
+#include <mutex>
+
+namespace {
+std::mutex &devicesMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::vector<DummyDeviceConfig> &devicesStorage()
+{
+    static std::vector<DummyDeviceConfig> devices{DummyDevices::defaultDevice()};
+    return devices;
+}
+
+const char *getEnv(const char *name)
+{
+    const char *value = std::getenv(name);
+    return value && *value ? value : nullptr;
+}
+} // namespace
+
+void DummyDevices::setDevices(std::vector<DummyDeviceConfig> devices)
+{
+    std::lock_guard<std::mutex> lock(devicesMutex());
+    devicesStorage() = std::move(devices);
+}
+
+std::vector<DummyDeviceConfig> DummyDevices::getDevices()
+{
+    std::lock_guard<std::mutex> lock(devicesMutex());
+    return devicesStorage();
+}
+
+std::optional<DummyDeviceConfig> DummyDevices::findDevice(const std::string &busId)
+{
+    std::lock_guard<std::mutex> lock(devicesMutex());
+    for (auto &d : devicesStorage()) {
+        if (d.busId == busId)
+            return d;
+    }
+    return {};
+}
+
+DummyDeviceConfig DummyDevices::defaultDevice()
+{
+    DummyDeviceConfig device;
+    if (const char *value = getEnv("RTAUDIO_DUMMY_JITTER_US"))
+        device.jitterUs = std::strtoul(value, nullptr, 10);
+    if (const char *value = getEnv("RTAUDIO_DUMMY_DRIFT_PPM"))
+        device.driftPpm = std::strtod(value, nullptr);
+    if (const char *value = getEnv("RTAUDIO_DUMMY_XRUN_MS"))
+        device.xrunIntervalMs = std::strtoul(value, nullptr, 10);
+    if (const char *value = getEnv("RTAUDIO_DUMMY_LOOPBACK"))
+        device.loopback = std::strtoul(value, nullptr, 10) != 0;
+    if (const char *value = getEnv("RTAUDIO_DUMMY_INPUT_FILE"))
+        device.inputFile = value;
+    if (const char *value = getEnv("RTAUDIO_DUMMY_OUTPUT_FILE"))
+        device.outputFile = value;
+    return device;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "RtAudio.h"
+#include <optional>
+#include <string>
+#include <vector>
+
+// A virtual device of the RTAUDIO_DUMMY api. Streams on it are clocked by
+// a timer thread at the nominal sample rate, no audio hardware is needed.
+struct DummyDeviceConfig
+{
+    std::string name = "Dummy";
+    std::string busId = "dummy";
+    unsigned int outputChannels = 2;
+    unsigned int inputChannels = 2;
+    std::vector<unsigned int> sampleRates = {44100, 48000, 96000};
+    unsigned int preferredSampleRate = 48000;
+    RtAudioFormat nativeFormats = RTAUDIO_SINT16 | RTAUDIO_SINT24 | RTAUDIO_SINT32
+                                  | RTAUDIO_FLOAT32 | RTAUDIO_FLOAT64;
+    bool isDefaultOutput = true;
+    bool isDefaultInput = true;
+    // Duplex streams capture their own output, delayed by the stream latency, instead of silence.
+    bool loopback = false;
+
+    // File backed devices. Capture reads the WAV or RF64 inputFile in
+    // place of silence, it sets the input channels, rate and format.
+    // Playback is written to the WAV outputFile. Both run at the pace of
+    // the device clock.
+    std::string inputFile;
+    std::string outputFile;
+    bool repeatInputFile = false; // Start over at the end instead of capturing silence.
+
+    // Fault injection, all disabled by default.
+    unsigned int jitterUs = 0;       // Each wake-up is delayed by a random amount up to this.
+    double driftPpm = 0;             // Deviation of the device clock from the nominal rate.
+    unsigned int xrunIntervalMs = 0; // A period is dropped and reported as xrun this often.
+};
+
+// The set of virtual devices. Changes apply to enumerators, probers and
+// streams created afterwards. The initial set is a single duplex device,
+// its fault injection can be set with the environment variables
+// RTAUDIO_DUMMY_JITTER_US, RTAUDIO_DUMMY_DRIFT_PPM, RTAUDIO_DUMMY_XRUN_MS
+// and RTAUDIO_DUMMY_LOOPBACK, its files with RTAUDIO_DUMMY_INPUT_FILE and
+// RTAUDIO_DUMMY_OUTPUT_FILE.
+class RTAUDIO_DLL_PUBLIC DummyDevices
+{
+public:
+    static void setDevices(std::vector<DummyDeviceConfig> devices);
+    static std::vector<DummyDeviceConfig> getDevices();
+    static std::optional<DummyDeviceConfig> findDevice(const std::string &busId);
+    static DummyDeviceConfig defaultDevice();
+};
@@ -0,0 +1,28 @@
+#include "RtApiDummyEnumerator.h"
+#include "DummyDevices.h"
+
+std::vector<RtAudio::DeviceInfoPartial> RtApiDummyEnumerator::listDevices()
+{
+    std::vector<RtAudio::DeviceInfoPartial> devices;
+    for (auto &d : DummyDevices::getDevices()) {
+        RtAudio::DeviceInfoPartial info;
+        info.name = d.name;
+        info.busID = d.busId;
+        info.supportsOutput = d.outputChannels > 0;
+        info.supportsInput = d.inputChannels > 0;
+        devices.push_back(info);
+    }
+    return devices;
+}
+
+std::string RtApiDummyEnumerator::getDefaultDevice(RtApi::StreamMode mode)
+{
+    for (auto &d : DummyDevices::getDevices()) {
+        bool output = d.isDefaultOutput && d.outputChannels > 0;
+        bool input = d.isDefaultInput && d.inputChannels > 0;
+        if ((mode == RtApi::OUTPUT && output) || (mode == RtApi::INPUT && input)
+            || (mode == RtApi::DUPLEX && output && input))
+            return d.busId;
+    }
+    return {};
+}
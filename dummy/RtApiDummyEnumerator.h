@@ -0,0 +1,14 @@
+#pragma once
+
+#include "RtAudio.h"
+
+class RtApiDummyEnumerator : public RtApiEnumerator
+{
+public:
+    RtApiDummyEnumerator() = default;
+    ~RtApiDummyEnumerator() = default;
+
+    RtAudio::Api getCurrentApi(void) override { return RtAudio::RTAUDIO_DUMMY; }
+    std::vector<RtAudio::DeviceInfoPartial> listDevices(void) override;
+    std::string getDefaultDevice(RtApi::StreamMode mode) override;
+};
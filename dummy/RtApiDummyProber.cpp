@@ -0,0 +1,44 @@
+#include "RtApiDummyProber.h"
+#include "DummyDevices.h"
+#include "WavFile.h"
+#include <algorithm>
+
+std::optional<RtAudio::DeviceInfo> RtApiDummyProber::probeDevice(const std::string &busId)
+{
+    auto device = DummyDevices::findDevice(busId);
+    if (!device) {
+        errorStream_ << "RtApiDummyProber::probeDevice: no device with bus ID " << busId << ".";
+        error(RTAUDIO_INVALID_DEVICE, errorStream_.str());
+        return {};
+    }
+    RtAudio::DeviceInfo info;
+    info.partial.name = device->name;
+    info.partial.busID = device->busId;
+    info.partial.supportsOutput = device->outputChannels > 0;
+    info.partial.supportsInput = device->inputChannels > 0;
+    info.outputChannels = device->outputChannels;
+    info.inputChannels = device->inputChannels;
+    info.duplexChannels = std::min(device->outputChannels, device->inputChannels);
+    info.isDefaultOutput = device->isDefaultOutput && device->outputChannels > 0;
+    info.isDefaultInput = device->isDefaultInput && device->inputChannels > 0;
+    info.sampleRates = device->sampleRates;
+    info.currentSampleRate = device->preferredSampleRate;
+    info.preferredSampleRate = device->preferredSampleRate;
+    info.nativeFormats = device->nativeFormats;
+    if (device->inputFile.empty() == false && device->inputChannels > 0) {
+        WavFileReader file;
+        if (file.open(device->inputFile) == false) {
+            errorStream_ << "RtApiDummyProber::probeDevice: " << device->inputFile << ": "
+                         << file.getErrorText() << ".";
+            error(RTAUDIO_WARNING, errorStream_.str());
+        } else {
+            // The file decides what the device captures.
+            info.inputChannels = file.format().channels;
+            info.duplexChannels = std::min(info.outputChannels, info.inputChannels);
+            info.sampleRates = {file.format().sampleRate};
+            info.currentSampleRate = file.format().sampleRate;
+            info.preferredSampleRate = file.format().sampleRate;
+        }
+    }
+    return info;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "RtAudio.h"
+
+class RtApiDummyProber : public RtApiProber
+{
+public:
+    RtApiDummyProber() = default;
+    ~RtApiDummyProber() = default;
+    RtAudio::Api getCurrentApi(void) override { return RtAudio::RTAUDIO_DUMMY; }
+    std::optional<RtAudio::DeviceInfo> probeDevice(const std::string &busId) override;
+};
@@ -0,0 +1,442 @@
+#include "RtApiDummyStream.h"
+#include "XrunStatistics.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#if defined(__linux__)
+#include <cerrno>
+#include <time.h>
+#else
+#include <thread>
+#endif
+
+namespace {
+// XrunStatistics::monotonicNowNs() is CLOCK_MONOTONIC on Linux, so its
+// values can be used as absolute deadlines directly.
+void sleepUntilNs(int64_t deadlineNs)
+{
+#if defined(__linux__)
+    struct timespec ts;
+    ts.tv_sec = deadlineNs / 1000000000;
+    ts.tv_nsec = deadlineNs % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+#else
+    std::this_thread::sleep_until(
+        std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deadlineNs)));
+#endif
+}
+
+// Seconds of the input file asked to be read ahead of the audio thread.
+constexpr unsigned int INPUT_PREFETCH_SECONDS = 1;
+} // namespace
+
+RtApiDummyStream::RtApiDummyStream(RtApi::RtApiStream stream,
+                                   DummyDeviceConfig device,
+                                   std::unique_ptr<WavFileMapping> inputFile,
+                                   std::unique_ptr<BufferedWavWriter> outputFile)
+    : RtApiStreamClass(std::move(stream))
+    , mDevice(std::move(device))
+    , mInputFile(std::move(inputFile))
+    , mOutputFile(std::move(outputFile))
+    , mThread([this]() { return threadMethod(); },
+              stream_.callbackInfo.doRealtime,
+              stream_.callbackInfo.priority)
+{
+    if (mThread.isValid() == false)
+        error(RTAUDIO_THREAD_ERROR, "RtApiDummy::error creating callback thread!");
+    setupLoopback();
+    if (mInputFile) {
+        mInputPrefetched = uint64_t(INPUT_PREFETCH_SECONDS) * stream_.sampleRate;
+        mInputFile->prefetch(0, mInputPrefetched);
+    }
+}
+
+RtApiDummyStream::~RtApiDummyStream()
+{
+    mThread.stop();
+    if (mOutputFile)
+        mOutputFile->close();
+}
+
+RtAudioErrorType RtApiDummyStream::startStream()
+{
+    if (stream_.state == RtApi::STREAM_WARM) {
+        mCallbackEnabled = true;
+        stream_.state = RtApi::STREAM_RUNNING;
+        return RTAUDIO_NO_ERROR;
+    }
+    if (stream_.state != RtApi::STREAM_STOPPED) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    mCallbackEnabled = true;
+    mRestartClock = true;
+    stream_.state = RtApi::STREAM_RUNNING;
+    mThread.resume();
+    return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiDummyStream::stopStream()
+{
+    if (stream_.state == RtApi::STREAM_PAUSED) {
+        stream_.state = RtApi::STREAM_STOPPED;
+        return RTAUDIO_NO_ERROR;
+    }
+    if (stream_.state != RtApi::STREAM_RUNNING && stream_.state != RtApi::STREAM_WARM) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    mThread.suspend();
+    stream_.state = RtApi::STREAM_STOPPED;
+    flushOutputFile();
+    return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiDummyStream::warmStream()
+{
+    if (stream_.state == RtApi::STREAM_RUNNING) {
+        mCallbackEnabled = false;
+        stream_.state = RtApi::STREAM_WARM;
+        return RTAUDIO_NO_ERROR;
+    }
+    if (stream_.state != RtApi::STREAM_STOPPED) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    mCallbackEnabled = false;
+    mRestartClock = true;
+    stream_.state = RtApi::STREAM_WARM;
+    mThread.resume();
+    return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiDummyStream::pauseStream()
+{
+    if (stream_.state != RtApi::STREAM_RUNNING && stream_.state != RtApi::STREAM_WARM) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    mThread.suspend();
+    mStateBeforePause = stream_.state;
+    stream_.state = RtApi::STREAM_PAUSED;
+    flushOutputFile();
+    return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiDummyStream::resumeStream()
+{
+    if (stream_.state != RtApi::STREAM_PAUSED) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    stream_.state = mStateBeforePause;
+    mRestartClock = true;
+    mThread.resume();
+    return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiDummyStream::reconfigure(unsigned int bufferSize, unsigned int sampleRate)
+{
+    if (stream_.state != RtApi::STREAM_STOPPED && stream_.state != RtApi::STREAM_PAUSED) {
+        return error(RTAUDIO_INVALID_USE, "RtApiDummyStream::reconfigure: the stream must be stopped or paused.");
+    }
+    if (bufferSize == 0
+        || std::find(mDevice.sampleRates.begin(), mDevice.sampleRates.end(), sampleRate)
+               == mDevice.sampleRates.end()) {
+        errorStream_ << "RtApiDummyStream::reconfigure: " << bufferSize << " frames at " << sampleRate
+                     << " Hz not supported by device (" << stream_.deviceId << ").";
+        return error(RTAUDIO_INVALID_PARAMETER, errorStream_.str());
+    }
+    if ((mInputFile || mOutputFile) && sampleRate != stream_.sampleRate) {
+        return error(RTAUDIO_INVALID_PARAMETER,
+                     "RtApiDummyStream::reconfigure: the sample rate of a file backed device is fixed.");
+    }
+    if (resizeStreamBuffers(bufferSize, sampleRate) == false) {
+        return RTAUDIO_MEMORY_ERROR;
+    }
+    if (stream_.mode != RtApi::INPUT)
+        stream_.latency[RtApi::OUTPUT] = bufferSize;
+    if (stream_.mode != RtApi::OUTPUT)
+        stream_.latency[RtApi::INPUT] = bufferSize;
+    setupLoopback();
+    return RTAUDIO_NO_ERROR;
+}
+
+bool RtApiDummyStream::threadMethod()
+{
+    if (mRestartClock.exchange(false)) {
+        restartClock();
+    } else {
+        mPeriods++;
+        waitForPeriod();
+    }
+    return processAudio();
+}
+
+bool RtApiDummyStream::processAudio()
+{
+    RtAudioStreamStatus status = 0;
+
+    if (stream_.mode != RtApi::INPUT && mXrunOutput == true) {
+        status |= RTAUDIO_OUTPUT_UNDERFLOW;
+        mXrunOutput = false;
+    }
+    if (stream_.mode != RtApi::OUTPUT && mXrunInput == true) {
+        status |= RTAUDIO_INPUT_OVERFLOW;
+        mXrunInput = false;
+    }
+
+    const char *input = stream_.userBuffer[RtApi::INPUT].get();
+    if (stream_.mode == RtApi::INPUT || stream_.mode == RtApi::DUPLEX)
+        input = processInput();
+
+    if (mCallbackEnabled == false) {
+        // Warm standby: the device consumes silence, the input is dropped.
+        if (stream_.mode == RtApi::OUTPUT || stream_.mode == RtApi::DUPLEX) {
+            memset(stream_.userBuffer[RtApi::OUTPUT].get(),
+                   0,
+                   stream_.nUserChannels[RtApi::OUTPUT] * stream_.bufferSize
+                       * RtApi::formatBytes(stream_.userFormat));
+            processOutput();
+        }
+        return true;
+    }
+
+    RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
+    int callbackResult = callback(stream_.userBuffer[RtApi::OUTPUT].get(),
+                                  const_cast<char *>(input),
+                                  stream_.bufferSize,
+                                  getStreamTime(),
+                                  status,
+                                  stream_.callbackInfo.userData);
+    if (callbackResult == 2) {
+        finishStream(false);
+        return true;
+    }
+
+    if (stream_.mode == RtApi::OUTPUT || stream_.mode == RtApi::DUPLEX)
+        processOutput();
+
+    tickStreamTime();
+    if (callbackResult == 1)
+        finishStream(true);
+    return true;
+}
+
+const char *RtApiDummyStream::processInput()
+{
+    char *buffer = nullptr;
+    unsigned int channels = 0;
+    RtAudioFormat format;
+
+    if (stream_.doConvertBuffer[RtApi::INPUT]) {
+        buffer = stream_.deviceBuffer.get();
+        channels = stream_.nDeviceChannels[RtApi::INPUT];
+        format = stream_.deviceFormat[RtApi::INPUT];
+    } else {
+        buffer = stream_.userBuffer[RtApi::INPUT].get();
+        channels = stream_.nUserChannels[RtApi::INPUT];
+        format = stream_.userFormat;
+    }
+
+    // Without conversion a file backed input may hand the mapped file to
+    // the callback directly, with conversion it is the source of it.
+    const char *captured = buffer;
+    unsigned int sampleBytes = RtApi::formatBytes(format);
+    if (mInputFile) {
+        captured = readInputFile(buffer);
+    } else {
+        memset(buffer, 0, channels * stream_.bufferSize * sampleBytes);
+    }
+    if (mLoopbackBuffer.empty() == false) {
+        // Both directions use the same device format, channels beyond the
+        // output channel count stay silent.
+        unsigned int outputChannels = stream_.nDeviceChannels[RtApi::OUTPUT];
+        unsigned int copied = std::min(channels, outputChannels);
+        const char *loopback = mLoopbackBuffer.data() + mLoopbackSlot * mLoopbackBuffer.size() / 2;
+        for (unsigned int i = 0; i < stream_.bufferSize; i++)
+            memcpy(buffer + i * channels * sampleBytes,
+                   loopback + i * outputChannels * sampleBytes,
+                   copied * sampleBytes);
+    }
+
+    if (stream_.doConvertBuffer[RtApi::INPUT] == false)
+        return captured;
+    RtApi::convertBuffer(stream_,
+                         stream_.userBuffer[RtApi::INPUT].get(),
+                         captured,
+                         stream_.convertInfo[RtApi::INPUT],
+                         stream_.bufferSize,
+                         RtApi::INPUT);
+    return stream_.userBuffer[RtApi::INPUT].get();
+}
+
+const char *RtApiDummyStream::readInputFile(char *buffer)
+{
+    // The device format and channel count of the stream are the ones of the file.
+    unsigned int frameBytes = mInputFile->format().frameBytes();
+    unsigned int sampleBytes = RtApi::formatBytes(mInputFile->format().format);
+    uint64_t fileFrames = mInputFile->frames();
+    uint64_t available = fileFrames - mInputPosition;
+
+    if (available >= stream_.bufferSize) {
+        const char *frames = mInputFile->data(mInputPosition);
+        // 24 bit samples are read bytewise, everything else needs natural alignment.
+        if (sampleBytes == 3 || reinterpret_cast<uintptr_t>(frames) % sampleBytes == 0) {
+            advanceInputFile(stream_.bufferSize);
+            return frames;
+        }
+    }
+
+    unsigned int done = 0;
+    while (done < stream_.bufferSize) {
+        available = fileFrames - mInputPosition;
+        if (available == 0) {
+            memset(buffer + size_t(done) * frameBytes, 0, size_t(stream_.bufferSize - done) * frameBytes);
+            break;
+        }
+        unsigned int count = unsigned(std::min<uint64_t>(available, stream_.bufferSize - done));
+        memcpy(buffer + size_t(done) * frameBytes, mInputFile->data(mInputPosition), size_t(count) * frameBytes);
+        advanceInputFile(count);
+        done += count;
+    }
+    return buffer;
+}
+
+void RtApiDummyStream::advanceInputFile(uint64_t frames)
+{
+    mInputPosition += frames;
+    if (mInputPosition == mInputFile->frames() && mDevice.repeatInputFile) {
+        mInputPosition = 0;
+        mInputPrefetched = 0;
+    }
+    // Asks for the next window once half of the current one was consumed,
+    // so the page cache stays ahead without a syscall every period.
+    uint64_t window = uint64_t(INPUT_PREFETCH_SECONDS) * stream_.sampleRate;
+    if (mInputPosition + window / 2 >= mInputPrefetched) {
+        mInputFile->prefetch(mInputPrefetched, window);
+        mInputPrefetched += window;
+    }
+}
+
+void RtApiDummyStream::processOutput()
+{
+    char *buffer = nullptr;
+    unsigned int channels = 0;
+    RtAudioFormat format;
+
+    if (stream_.doConvertBuffer[RtApi::OUTPUT]) {
+        buffer = stream_.deviceBuffer.get();
+        RtApi::convertBuffer(stream_,
+                             buffer,
+                             stream_.userBuffer[RtApi::OUTPUT].get(),
+                             stream_.convertInfo[RtApi::OUTPUT],
+                             stream_.bufferSize,
+                             RtApi::OUTPUT);
+        channels = stream_.nDeviceChannels[RtApi::OUTPUT];
+        format = stream_.deviceFormat[RtApi::OUTPUT];
+    } else {
+        buffer = stream_.userBuffer[RtApi::OUTPUT].get();
+        channels = stream_.nUserChannels[RtApi::OUTPUT];
+        format = stream_.userFormat;
+    }
+
+    // The virtual device plays nothing. Duplex loopback overwrites the
+    // slot the input just read, so it is captured two periods later like
+    // on a device with one period of latency in each direction.
+    if (mLoopbackBuffer.empty() == false) {
+        memcpy(mLoopbackBuffer.data() + mLoopbackSlot * mLoopbackBuffer.size() / 2,
+               buffer,
+               channels * stream_.bufferSize * RtApi::formatBytes(format));
+        mLoopbackSlot ^= 1;
+    }
+    if (mOutputFile)
+        mOutputFile->push(buffer, stream_.bufferSize);
+}
+
+void RtApiDummyStream::restartClock()
+{
+    // A device clock running fast by driftPpm completes its periods earlier.
+    double nominalNs = stream_.bufferSize * 1e9 / stream_.sampleRate;
+    mPeriodNs = nominalNs / (1.0 + mDevice.driftPpm * 1e-6);
+    mClockStartNs = XrunStatistics::monotonicNowNs();
+    mPeriods = 0;
+    mNextInjectedXrunNs = mClockStartNs + int64_t(mDevice.xrunIntervalMs) * 1000000;
+    mXrunOutput = false;
+    mXrunInput = false;
+    std::fill(mLoopbackBuffer.begin(), mLoopbackBuffer.end(), 0);
+}
+
+void RtApiDummyStream::waitForPeriod()
+{
+    unsigned long framesLost = 0;
+    uint64_t detectedNs = 0;
+
+    int64_t periodStartNs = mClockStartNs + int64_t(mPeriods * mPeriodNs);
+    if (mDevice.xrunIntervalMs > 0 && periodStartNs >= mNextInjectedXrunNs) {
+        // Injected xrun: the thread stalls and a whole period passes unprocessed.
+        mNextInjectedXrunNs += int64_t(mDevice.xrunIntervalMs) * 1000000;
+        mPeriods++;
+        framesLost += stream_.bufferSize;
+        detectedNs = periodStartNs;
+        periodStartNs = mClockStartNs + int64_t(mPeriods * mPeriodNs);
+    }
+
+    int64_t wakeNs = periodStartNs;
+    if (mDevice.jitterUs > 0)
+        wakeNs += std::uniform_int_distribution<int64_t>(0, int64_t(mDevice.jitterUs) * 1000)(mRandom);
+    sleepUntilNs(wakeNs);
+
+    // Woken, or finished the previous period, later than the end of this
+    // one: the device moved on without us.
+    int64_t nowNs = XrunStatistics::monotonicNowNs();
+    if (nowNs - periodStartNs >= mPeriodNs) {
+        uint64_t missed = uint64_t((nowNs - periodStartNs) / mPeriodNs);
+        mPeriods += missed;
+        framesLost += missed * stream_.bufferSize;
+        detectedNs = nowNs;
+    }
+    if (framesLost == 0)
+        return;
+
+    std::fill(mLoopbackBuffer.begin(), mLoopbackBuffer.end(), 0);
+    if (stream_.mode != RtApi::INPUT) {
+        mXrunOutput = true;
+        registerXrun(RTAUDIO_OUTPUT_UNDERFLOW, detectedNs, framesLost, 0);
+    }
+    if (stream_.mode != RtApi::OUTPUT) {
+        mXrunInput = true;
+        registerXrun(RTAUDIO_INPUT_OVERFLOW, detectedNs, framesLost, 0);
+    }
+}
+
+void RtApiDummyStream::finishStream(bool drain)
+{
+    // Draining lasts until the device consumed the period just written.
+    if (drain)
+        sleepUntilNs(mClockStartNs + int64_t((mPeriods + 1) * mPeriodNs));
+    mThread.requestSuspend();
+    stream_.state = RtApi::STREAM_STOPPED;
+    notifyStreamFinished(RTAUDIO_NO_ERROR);
+}
+
+void RtApiDummyStream::setupLoopback()
+{
+    mLoopbackBuffer.clear();
+    if (!mDevice.loopback || stream_.mode != RtApi::DUPLEX || mInputFile)
+        return;
+    mLoopbackBuffer.assign(2 * stream_.nDeviceChannels[RtApi::OUTPUT] * stream_.bufferSize
+                               * RtApi::formatBytes(stream_.deviceFormat[RtApi::OUTPUT]),
+                           0);
+    mLoopbackSlot = 0;
+}
+
+void RtApiDummyStream::flushOutputFile()
+{
+    if (!mOutputFile)
+        return;
+    mOutputFile->flush();
+    uint64_t dropped = mOutputFile->droppedFrames();
+    if (dropped != mReportedDroppedFrames) {
+        errorStream_ << "RtApiDummyStream: the output file could not keep up, "
+                     << dropped - mReportedDroppedFrames << " frames were dropped.";
+        error(RTAUDIO_WARNING, errorStream_.str());
+        mReportedDroppedFrames = dropped;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "BufferedWavWriter.h"
+#include "DummyDevices.h"
+#include "RtAudio.h"
+#include "ThreadSuspendable.h"
+#include "WavFile.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+class RtApiDummyStream : public RtApiStreamClass
+{
+public:
+    RtApiDummyStream(RtApi::RtApiStream stream,
+                     DummyDeviceConfig device,
+                     std::unique_ptr<WavFileMapping> inputFile = {},
+                     std::unique_ptr<BufferedWavWriter> outputFile = {});
+    ~RtApiDummyStream();
+    RtAudio::Api getCurrentApi(void) override { return RtAudio::RTAUDIO_DUMMY; }
+    RtAudioErrorType startStream(void) override;
+    RtAudioErrorType stopStream(void) override;
+    RtAudioErrorType warmStream(void) override;
+    RtAudioErrorType pauseStream(void) override;
+    RtAudioErrorType resumeStream(void) override;
+    RtAudioErrorType reconfigure(unsigned int bufferSize, unsigned int sampleRate) override;
+
+private:
+    bool threadMethod();
+    bool processAudio();
+    const char *processInput();
+    const char *readInputFile(char *buffer);
+    void advanceInputFile(uint64_t frames);
+    void processOutput();
+    void restartClock();
+    void waitForPeriod();
+    void checkXruns();
+    void finishStream(bool drain);
+    void setupLoopback();
+    void flushOutputFile();
+
+    DummyDeviceConfig mDevice;
+
+    // Device timeline: period n starts at mClockStartNs + n * mPeriodNs.
+    int64_t mClockStartNs = 0;
+    uint64_t mPeriods = 0;
+    double mPeriodNs = 0;
+    int64_t mNextInjectedXrunNs = 0;
+    std::minstd_rand mRandom;
+
+    // Device format output of the last two periods, captured by duplex loopback streams.
+    std::vector<char> mLoopbackBuffer;
+    unsigned int mLoopbackSlot = 0;
+
+    // File backed devices. The input is read from a private mapping of the
+    // file, the output is written by the writer thread of mOutputFile.
+    std::unique_ptr<WavFileMapping> mInputFile;
+    uint64_t mInputPosition = 0;
+    uint64_t mInputPrefetched = 0;
+    std::unique_ptr<BufferedWavWriter> mOutputFile;
+    uint64_t mReportedDroppedFrames = 0;
+
+    bool mXrunOutput = false;
+    bool mXrunInput = false;
+
+    std::atomic_bool mRestartClock = true;
+    std::atomic_bool mCallbackEnabled = false;
+    RtApi::StreamState mStateBeforePause = RtApi::STREAM_STOPPED;
+
+    // Declared last, so the thread is stopped before the members above go away.
+    ThreadSuspendable mThread;
+};
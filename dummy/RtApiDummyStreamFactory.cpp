@@ -0,0 +1,117 @@
+#include "RtApiDummyStreamFactory.h"
+#include "BufferedWavWriter.h"
+#include "DummyDevices.h"
+#include "RtApiDummyStream.h"
+#include "WavFile.h"
+#include <algorithm>
+
+namespace {
+constexpr unsigned int DUMMY_DEFAULT_BUFFER_SIZE = 256;
+
+RtAudioFormat negotiateDeviceFormat(RtAudioFormat nativeFormats, RtAudioFormat userFormat)
+{
+    if (nativeFormats & userFormat)
+        return userFormat;
+    for (RtAudioFormat f : {RTAUDIO_FLOAT64, RTAUDIO_FLOAT32, RTAUDIO_SINT32, RTAUDIO_SINT24,
+                            RTAUDIO_SINT16, RTAUDIO_SINT8}) {
+        if (nativeFormats & f)
+            return f;
+    }
+    return 0;
+}
+} // namespace
+
+std::shared_ptr<RtApiStreamClass> RtApiDummyStreamFactory::createStream(CreateStreamParams params)
+{
+    auto device = DummyDevices::findDevice(params.busId);
+    if (!device) {
+        errorStream_ << "RtApiDummyStreamFactory::createStream: no device with bus ID " << params.busId << ".";
+        error(RTAUDIO_INVALID_DEVICE, errorStream_.str());
+        return {};
+    }
+    bool output = params.mode == RtApi::OUTPUT || params.mode == RtApi::DUPLEX;
+    bool input = params.mode == RtApi::INPUT || params.mode == RtApi::DUPLEX;
+    if (!output && !input) {
+        error(RTAUDIO_INVALID_PARAMETER, "RtApiDummyStreamFactory::createStream: invalid stream mode.");
+        return {};
+    }
+    // A file backed input replaces the configured input channels and
+    // rates with the ones of the file.
+    std::unique_ptr<WavFileMapping> inputFile;
+    if (input && device->inputFile.empty() == false) {
+        inputFile = std::make_unique<WavFileMapping>();
+        if (inputFile->open(device->inputFile) == false) {
+            errorStream_ << "RtApiDummyStreamFactory::createStream: " << inputFile->getErrorText();
+            error(RTAUDIO_INVALID_DEVICE, errorStream_.str());
+            return {};
+        }
+        device->inputChannels = inputFile->format().channels;
+        device->sampleRates = {inputFile->format().sampleRate};
+    }
+    if ((output && (params.channelsOutput == 0 || params.channelsOutput > device->outputChannels))
+        || (input && (params.channelsInput == 0 || params.channelsInput > device->inputChannels))) {
+        errorStream_ << "RtApiDummyStreamFactory::createStream: device (" << params.busId
+                     << ") does not support the requested channel count.";
+        error(RTAUDIO_INVALID_PARAMETER, errorStream_.str());
+        return {};
+    }
+    if (std::find(device->sampleRates.begin(), device->sampleRates.end(), params.sampleRate)
+        == device->sampleRates.end()) {
+        errorStream_ << "RtApiDummyStreamFactory::createStream: device (" << params.busId
+                     << ") does not support sample rate " << params.sampleRate << ".";
+        error(RTAUDIO_INVALID_PARAMETER, errorStream_.str());
+        return {};
+    }
+    RtAudioFormat deviceFormat = negotiateDeviceFormat(device->nativeFormats, params.format);
+    if (deviceFormat == 0 || RtApi::formatBytes(params.format) == 0) {
+        error(RTAUDIO_INVALID_PARAMETER, "RtApiDummyStreamFactory::createStream: unsupported sample format.");
+        return {};
+    }
+    if (params.bufferSize == 0)
+        params.bufferSize = DUMMY_DEFAULT_BUFFER_SIZE;
+
+    RtApi::RtApiStream stream_{};
+    // WAV files have no 8 bit signed format.
+    if (output && device->outputFile.empty() == false && WavFormat::isSupported(deviceFormat) == false)
+        deviceFormat = RTAUDIO_SINT16;
+    if (output) {
+        stream_.deviceFormat[RtApi::OUTPUT] = deviceFormat;
+        stream_.nDeviceChannels[RtApi::OUTPUT] = params.channelsOutput;
+        stream_.deviceInterleaved[RtApi::OUTPUT] = true;
+        stream_.latency[RtApi::OUTPUT] = params.bufferSize;
+    }
+    if (input && inputFile) {
+        stream_.deviceFormat[RtApi::INPUT] = inputFile->format().format;
+        stream_.nDeviceChannels[RtApi::INPUT] = inputFile->format().channels;
+        stream_.deviceInterleaved[RtApi::INPUT] = true;
+        stream_.latency[RtApi::INPUT] = params.bufferSize;
+    } else if (input) {
+        stream_.deviceFormat[RtApi::INPUT] = deviceFormat;
+        stream_.nDeviceChannels[RtApi::INPUT] = params.channelsInput;
+        stream_.deviceInterleaved[RtApi::INPUT] = true;
+        stream_.latency[RtApi::INPUT] = params.bufferSize;
+    }
+    stream_.nBuffers = 1;
+    if (setupStreamWithParams(stream_, params) == false) {
+        return {};
+    }
+    if (setupStreamCommon(stream_) == false) {
+        return {};
+    }
+    std::unique_ptr<BufferedWavWriter> outputFile;
+    if (output && device->outputFile.empty() == false) {
+        outputFile = std::make_unique<BufferedWavWriter>();
+        if (outputFile->open(device->outputFile,
+                             {params.channelsOutput, params.sampleRate, deviceFormat},
+                             stream_.bufferSize)
+            == false) {
+            errorStream_ << "RtApiDummyStreamFactory::createStream: " << outputFile->getErrorText();
+            error(RTAUDIO_SYSTEM_ERROR, errorStream_.str());
+            return {};
+        }
+    }
+    return std::make_shared<RtApiDummyStream>(std::move(stream_),
+                                              std::move(device.value()),
+                                              std::move(inputFile),
+                                              std::move(outputFile));
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "RtAudio.h"
+
+class RtApiDummyStreamFactory : public RtApiStreamClassFactory
+{
+public:
+    RtApiDummyStreamFactory() = default;
+    ~RtApiDummyStreamFactory() = default;
+    RtAudio::Api getCurrentApi(void) override { return RtAudio::RTAUDIO_DUMMY; }
+    std::shared_ptr<RtApiStreamClass> createStream(CreateStreamParams params) override;
+};
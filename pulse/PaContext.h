@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include <memory>
 #include <pulse/def.h>
 
@@ -25,5 +26,6 @@ public:
 private:
     pa_context *mContext = NULL;
     std::shared_ptr<PaMainloop> mMainloop;
-    pa_context_state mState = PA_CONTEXT_UNCONNECTED;
+    // Written on the event thread, hasError() may be called from any thread.
+    std::atomic<pa_context_state> mState = PA_CONTEXT_UNCONNECTED;
 };
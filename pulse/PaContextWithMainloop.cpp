@@ -1,14 +1,44 @@
 #include "PaContextWithMainloop.h"
+#include "ThreadSuspendable.h"
 #include "pulse/PaContext.h"
 #include "pulse/PaMainloop.h"
+#include <algorithm>
+#include <cassert>
+#include <pulse/context.h>
+#include <pulse/subscribe.h>
 
-std::shared_ptr<PaContextWithMainloop> PaContextWithMainloop::Create(const char *server)
+namespace {
+std::mutex sharedConnectionMutex;
+std::weak_ptr<PaContextWithMainloop> sharedConnection;
+
+void rt_pa_context_subscribe_cb(pa_context *, pa_subscription_event_type_t t, uint32_t idx, void *userdata)
+{
+    assert(userdata);
+    auto *connection = static_cast<PaContextWithMainloop *>(userdata);
+    connection->handleEvent(t, idx);
+}
+
+void rt_pa_context_success_cb(pa_context *, int success, void *userdata)
+{
+    assert(userdata);
+    auto *successOut = static_cast<int *>(userdata);
+    (*successOut) = success;
+}
+} // namespace
+
+std::shared_ptr<PaContextWithMainloop> PaContextWithMainloop::GetShared()
 {
-    auto context = std::shared_ptr<PaContextWithMainloop>(new PaContextWithMainloop(server));
-    if (context->isValid() == false) {
+    std::lock_guard<std::mutex> guard(sharedConnectionMutex);
+    auto connection = sharedConnection.lock();
+    if (connection && connection->getContext()->hasError() == false)
+        return connection;
+    // Holders of a failed connection keep it until they let it go.
+    connection = std::shared_ptr<PaContextWithMainloop>(new PaContextWithMainloop(nullptr));
+    if (connection->isValid() == false) {
         return {};
     }
-    return context;
+    sharedConnection = connection;
+    return connection;
 }
 
 std::shared_ptr<PaContext> PaContextWithMainloop::getContext() const
@@ -16,6 +46,11 @@ std::shared_ptr<PaContext> PaContextWithMainloop::getContext() const
     return mContext;
 }
 
+std::shared_ptr<PaMainloop> PaContextWithMainloop::getMainloop() const
+{
+    return mMainloop;
+}
+
 PaContextWithMainloop::PaContextWithMainloop(const char *server)
 {
     mMainloop = std::make_shared<PaMainloop>();
@@ -31,12 +66,108 @@ PaContextWithMainloop::PaContextWithMainloop(const char *server)
     if (mContext->connect(server) == false) {
         return;
     }
+    mMainloop->startThreading();
+    mEventThread = std::make_unique<ThreadSuspendable>([this]() { return mMainloop->iterateBlocking(); });
+    if (mEventThread->isValid() == false) {
+        return;
+    }
+    mEventThread->resume();
     mValid = true;
 }
 
-PaContextWithMainloop::~PaContextWithMainloop() {}
+PaContextWithMainloop::~PaContextWithMainloop()
+{
+    if (mEventThread) {
+        // The quit request wakes the thread up from its poll.
+        {
+            PaMainloop::Lock lock(*mMainloop);
+            mMainloop->stop();
+        }
+        mEventThread->stop();
+    }
+    if (mContext && mContext->isValid())
+        pa_context_set_subscribe_callback(mContext->handle(), nullptr, nullptr);
+}
 
 bool PaContextWithMainloop::isValid() const
 {
     return mValid;
 }
+
+int PaContextWithMainloop::requestRealtime(int priority)
+{
+    std::lock_guard<std::mutex> guard(mPriorityMutex);
+    int id = mNextRealtimeId++;
+    mRealtimeRequests.emplace(id, priority);
+    if (applyPriority() == false) {
+        mRealtimeRequests.erase(id);
+        return 0;
+    }
+    return id;
+}
+
+void PaContextWithMainloop::releaseRealtime(int id)
+{
+    std::lock_guard<std::mutex> guard(mPriorityMutex);
+    if (mRealtimeRequests.erase(id))
+        applyPriority();
+}
+
+bool PaContextWithMainloop::applyPriority()
+{
+    int priority = -1;
+    for (const auto &request : mRealtimeRequests)
+        priority = std::max(priority, request.second);
+    if (priority == mRealtimePriority)
+        return true;
+    if (mEventThread->setPriority(priority >= 0, priority) == false)
+        return false;
+    mRealtimePriority = priority;
+    return true;
+}
+
+int PaContextWithMainloop::addSubscriber(SubscriptionCallback callback)
+{
+    PaMainloop::Lock lock(*mMainloop);
+    if (mSubscribed == false && subscribe() == false)
+        return 0;
+    int id = mNextSubscriberId++;
+    mSubscribers.emplace(id, std::move(callback));
+    return id;
+}
+
+void PaContextWithMainloop::removeSubscriber(int id)
+{
+    // Once this returns the callback is not running and never called again.
+    PaMainloop::Lock lock(*mMainloop);
+    mSubscribers.erase(id);
+}
+
+void PaContextWithMainloop::handleEvent(pa_subscription_event_type_t t, uint32_t idx)
+{
+    // A subscriber may remove itself from its callback.
+    for (auto it = mSubscribers.begin(); it != mSubscribers.end();) {
+        auto current = it++;
+        current->second(t, idx);
+    }
+}
+
+bool PaContextWithMainloop::subscribe()
+{
+    // Stream, client and module events are frequent and of no interest,
+    // the server does not even send them.
+    pa_context_set_subscribe_callback(mContext->handle(), rt_pa_context_subscribe_cb, this);
+    int success = 100;
+    pa_operation *operation = pa_context_subscribe(mContext->handle(),
+                                                   static_cast<pa_subscription_mask_t>(
+                                                       PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SOURCE
+                                                       | PA_SUBSCRIPTION_MASK_SERVER | PA_SUBSCRIPTION_MASK_CARD),
+                                                   &rt_pa_context_success_cb,
+                                                   &success);
+    if (!operation)
+        return false;
+    mMainloop->runUntil([&]() { return mContext->hasError() || success != 100; });
+    PaMainloop::releaseOperation(operation);
+    mSubscribed = success == 1;
+    return mSubscribed;
+}
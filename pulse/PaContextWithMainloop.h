@@ -1,22 +1,56 @@
 #pragma once
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <pulse/def.h>
 
 class PaMainloop;
 class PaContext;
+class ThreadSuspendable;
 
+// Connection to the pulse server shared by everything in the process:
+// enumeration, probing, notifications and any number of streams run on
+// one context and one event thread. The connection lives as long as
+// somebody holds it and is opened again once the server dropped it.
 class PaContextWithMainloop
 {
 public:
-    static std::shared_ptr<PaContextWithMainloop> Create(const char *server);
+    static std::shared_ptr<PaContextWithMainloop> GetShared();
     std::shared_ptr<PaContext> getContext() const;
+    std::shared_ptr<PaMainloop> getMainloop() const;
+
+    // The event thread runs at the highest priority a stream asked for and
+    // returns to normal scheduling once the last request is released.
+    // Returns the id of the request, 0 on failure.
+    int requestRealtime(int priority);
+    void releaseRealtime(int id);
+
+    // The context has a single subscription callback for sink, source,
+    // server and card events, they are passed on to every subscriber on
+    // the event thread. Returns 0 on failure.
+    using SubscriptionCallback = std::function<void(pa_subscription_event_type_t t, uint32_t idx)>;
+    int addSubscriber(SubscriptionCallback callback);
+    void removeSubscriber(int id);
+    void handleEvent(pa_subscription_event_type_t t, uint32_t idx);
 
     ~PaContextWithMainloop();
 
 private:
     PaContextWithMainloop(const char *server);
     bool isValid() const;
+    bool subscribe();
+    bool applyPriority();
 
     std::shared_ptr<PaMainloop> mMainloop;
     std::shared_ptr<PaContext> mContext;
+    std::unique_ptr<ThreadSuspendable> mEventThread;
+    std::map<int, SubscriptionCallback> mSubscribers;
+    int mNextSubscriberId = 1;
+    bool mSubscribed = false;
+    std::mutex mPriorityMutex;
+    std::map<int, int> mRealtimeRequests;
+    int mNextRealtimeId = 1;
+    int mRealtimePriority = -1;
     bool mValid = false;
 };
@@ -2,9 +2,22 @@
 #include <cassert>
 #include <cstdint>
 #include <cstdio>
+#include <poll.h>
 #include <pulse/mainloop.h>
 #include <pulse/operation.h>
 
+namespace {
+int rt_pa_poll_unlocked(struct pollfd *ufds, unsigned long nfds, int timeout, void *userdata)
+{
+    // Other threads may use the loop while the event thread sleeps.
+    auto *loop = static_cast<PaMainloop *>(userdata);
+    loop->unlock();
+    int result = poll(ufds, nfds, timeout);
+    loop->lock();
+    return result;
+}
+} // namespace
+
 PaMainloop::PaMainloop()
 {
     mMainloop = pa_mainloop_new();
@@ -14,6 +27,17 @@ bool PaMainloop::runUntil(std::function<bool()> postdicate)
 {
     if (!isValid())
         return false;
+    Lock guard(*this);
+    if (mThreaded) {
+        // Called from a callback, the iteration it would wait for never comes.
+        if (isEventThread())
+            return false;
+        while (postdicate() == false) {
+            if (waitIteration() == false)
+                return false;
+        }
+        return true;
+    }
     do {
         int retVal = 0;
         if (pa_mainloop_iterate(mMainloop, 1, &retVal) < 0) {
@@ -25,17 +49,102 @@ bool PaMainloop::runUntil(std::function<bool()> postdicate)
     return true;
 }
 
+void PaMainloop::releaseOperation(pa_operation *oper)
+{
+    if (!oper)
+        return;
+    if (pa_operation_get_state(oper) == PA_OPERATION_RUNNING)
+        pa_operation_cancel(oper);
+    pa_operation_unref(oper);
+}
+
 bool PaMainloop::iterateBlocking()
 {
     if (!isValid())
         return false;
+    Lock guard(*this);
+    mEventThread = std::this_thread::get_id();
     int retVal = 0;
-    if (pa_mainloop_iterate(mMainloop, 1, &retVal) < 0) {
+    bool success = pa_mainloop_iterate(mMainloop, 1, &retVal) >= 0;
+    if (success)
+        processAsyncTasks();
+    else
         mErrorWhileRunning = true;
-        return false;
+    {
+        std::lock_guard<std::mutex> g(mLockMutex);
+        mIteration++;
+        mEventThreadDone = !success;
     }
-    processAsyncTasks();
-    return true;
+    mLockChanged.notify_all();
+    return success;
+}
+
+void PaMainloop::startThreading()
+{
+    if (!isValid())
+        return;
+    mThreaded = true;
+    pa_mainloop_set_poll_func(mMainloop, rt_pa_poll_unlocked, this);
+}
+
+bool PaMainloop::isEventThread() const
+{
+    return mEventThread.load() == std::this_thread::get_id();
+}
+
+void PaMainloop::lock()
+{
+    std::thread::id self = std::this_thread::get_id();
+    std::unique_lock<std::mutex> g(mLockMutex);
+    if (mOwner == self) {
+        mDepth++;
+        return;
+    }
+    mLockChanged.wait(g, [this]() { return mDepth == 0; });
+    mOwner = self;
+    mDepth = 1;
+}
+
+void PaMainloop::unlock()
+{
+    {
+        std::lock_guard<std::mutex> g(mLockMutex);
+        assert(mOwner == std::this_thread::get_id() && mDepth > 0);
+        if (--mDepth > 0)
+            return;
+        mOwner = std::thread::id();
+        mLockChanged.notify_all();
+    }
+    if (mThreaded && isEventThread() == false)
+        wakeup();
+}
+
+void PaMainloop::wakeup()
+{
+    // Requests made by other threads sit in the context until the event
+    // thread polls again, which may take until the next server event.
+    pa_mainloop_wakeup(mMainloop);
+}
+
+bool PaMainloop::waitIteration()
+{
+    // Releases every level of the lock until the event thread completed
+    // an iteration, then takes it back at the same depth.
+    std::thread::id self = std::this_thread::get_id();
+    std::unique_lock<std::mutex> g(mLockMutex);
+    assert(mOwner == self);
+    unsigned int depth = mDepth;
+    uint64_t iteration = mIteration;
+    mOwner = std::thread::id();
+    mDepth = 0;
+    mLockChanged.notify_all();
+    wakeup();
+    mLockChanged.wait(g, [&]() {
+        return (mIteration != iteration || mEventThreadDone) && mDepth == 0;
+    });
+    mOwner = self;
+    mDepth = depth;
+    return mEventThreadDone == false;
 }
 
 bool PaMainloop::stop()
@@ -67,9 +176,10 @@ void PaMainloop::processAsyncTasks()
 
 void PaMainloop::cancelAllTasks()
 {
-    for (auto it = mTasks.begin(); it != mTasks.end();) {
-        (*it)->cancel();
+    for (auto &task : mTasks) {
+        task->cancel();
     }
+    mTasks.clear();
 }
 
 PaMainloop::~PaMainloop()
@@ -78,6 +188,8 @@ PaMainloop::~PaMainloop()
         return;
     stop();
     cancelAllTasks();
+    if (mThreaded)
+        pa_mainloop_set_poll_func(mMainloop, nullptr, nullptr);
     if (mErrorWhileRunning == false) {
         pa_mainloop_run(mMainloop, nullptr);
     }
@@ -1,7 +1,12 @@
 #pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <list>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 struct pa_mainloop;
 struct pa_operation;
@@ -34,16 +39,63 @@ public:
     PaMainloop(const PaMainloop &) = delete;
     PaMainloop &operator=(const PaMainloop &) = delete;
 
+    // Iterates until the predicate holds. Once an event thread runs the
+    // loop, the calling thread only waits for its iterations instead. The
+    // event thread itself can not wait and gets false right away.
     bool runUntil(std::function<bool()>);
+    // Releases an operation waited for with runUntil(). One still running
+    // is cancelled, so its callback never writes into the state of a
+    // caller that already returned.
+    static void releaseOperation(pa_operation *oper);
+    // Iteration of the event thread, see startThreading().
     bool iterateBlocking();
     bool stop();
     bool addTask(std::shared_ptr<PaMainloopTask> task);
 
+    // Hands the loop over to a single event thread calling iterateBlocking().
+    // The thread holds the loop lock except while it polls, every other
+    // thread must hold it around calls into the pulse API.
+    void startThreading();
+    bool isEventThread() const;
+
+    // Recursive, runUntil() releases all levels while it waits. Releasing
+    // the last level on another thread wakes the event thread up, so the
+    // requests made under the lock go out right away.
+    void lock();
+    void unlock();
+    void wakeup();
+
+    class Lock
+    {
+    public:
+        explicit Lock(PaMainloop &loop)
+            : mLoop(loop)
+        {
+            mLoop.lock();
+        }
+        ~Lock() { mLoop.unlock(); }
+        Lock(const Lock &) = delete;
+        Lock &operator=(const Lock &) = delete;
+
+    private:
+        PaMainloop &mLoop;
+    };
+
 private:
     void processAsyncTasks();
     void cancelAllTasks();
+    bool waitIteration();
 
     bool mErrorWhileRunning = false;
     pa_mainloop *mMainloop = NULL;
     std::list<std::shared_ptr<PaMainloopTask>> mTasks;
+
+    bool mThreaded = false;
+    std::atomic<std::thread::id> mEventThread;
+    std::mutex mLockMutex;
+    std::condition_variable mLockChanged;
+    std::thread::id mOwner;
+    unsigned int mDepth = 0;
+    uint64_t mIteration = 0;
+    bool mEventThreadDone = false;
 };
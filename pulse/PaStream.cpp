@@ -36,6 +36,20 @@ void rt_pa_stream_request_cb(pa_stream *p, size_t nbytes, void *userdata)
     stream->streamRequest(p, nbytes);
 }
 
+void rt_pa_stream_underflow_cb(pa_stream *p, void *userdata)
+{
+    assert(userdata);
+    auto *stream = reinterpret_cast<PaStream *>(userdata);
+    stream->streamUnderflow(p);
+}
+
+void rt_pa_stream_overflow_cb(pa_stream *p, void *userdata)
+{
+    assert(userdata);
+    auto *stream = reinterpret_cast<PaStream *>(userdata);
+    stream->streamOverflow(p);
+}
+
 } // namespace
 
 PaStream::PaStream(std::shared_ptr<PaContext> context,
@@ -54,20 +68,27 @@ PaStream::PaStream(std::shared_ptr<PaContext> context,
     pa_stream_set_write_callback(mStream, rt_pa_stream_request_cb, this);
     pa_stream_set_read_callback(mStream, rt_pa_stream_request_cb, this);
     pa_stream_set_moved_callback(mStream, rt_pa_stream_notify_cb, this);
+    pa_stream_set_underflow_callback(mStream, rt_pa_stream_underflow_cb, this);
+    pa_stream_set_overflow_callback(mStream, rt_pa_stream_overflow_cb, this);
 }
 
-bool PaStream::connect(const char *dev, pa_buffer_attr bufAttr, bool input)
+bool PaStream::connect(const char *dev, pa_buffer_attr bufAttr, bool input, bool variableRate)
 {
     if (!isValid())
         return false;
     mDeviceBusId = dev;
     mBufferAttr = bufAttr;
     mInput = input;
+    mVariableRate = variableRate;
     auto loop = mContext->getMainloop();
     if (!loop) {
         return false;
     }
-    int flags = PA_STREAM_START_CORKED | PA_STREAM_ADJUST_LATENCY | PA_STREAM_DONT_MOVE;
+    PaMainloop::Lock lock(*loop);
+    int flags = PA_STREAM_START_CORKED | PA_STREAM_ADJUST_LATENCY | PA_STREAM_DONT_MOVE
+                | PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE;
+    if (variableRate)
+        flags |= PA_STREAM_VARIABLE_RATE;
     if (input) {
         if (pa_stream_connect_record(mStream, dev, &bufAttr, (pa_stream_flags) flags) != 0) {
             return false;
@@ -90,19 +111,24 @@ bool PaStream::connect(const char *dev, pa_buffer_attr bufAttr, bool input)
     }
     if (mState != PA_STREAM_READY)
         return false;
+    storeBufferAttr(bufAttr);
     return true;
 }
 
 PaStream::~PaStream()
 {
-    if (mStream) {
+    if (!mStream) {
         return;
     }
+    // Callbacks of the event thread can not run while the lock is held.
+    PaMainloop::Lock lock(*mContext->getMainloop());
     pa_stream_disconnect(mStream);
     pa_stream_set_state_callback(mStream, nullptr, this);
     pa_stream_set_write_callback(mStream, nullptr, this);
     pa_stream_set_read_callback(mStream, nullptr, this);
     pa_stream_set_moved_callback(mStream, nullptr, this);
+    pa_stream_set_underflow_callback(mStream, nullptr, this);
+    pa_stream_set_overflow_callback(mStream, nullptr, this);
     pa_stream_unref(mStream);
 }
 
@@ -114,13 +140,14 @@ bool PaStream::isValid() const
 void PaStream::setState(pa_stream *stream)
 {
     assert(stream == mStream);
+    bool failed = hasError();
     mState = pa_stream_get_state(mStream);
     auto devName = pa_stream_get_device_name(mStream);
-    if (!devName)
-        return;
-    if (devName != mDeviceBusId) {
+    if (devName && devName != mDeviceBusId) {
         mStreamMoved = true;
     }
+    if (failed == false && hasError() && mFailureCallback)
+        mFailureCallback();
 }
 
 void PaStream::streamRequest(pa_stream *p, size_t nbytes)
@@ -144,52 +171,150 @@ bool PaStream::hasError() const
 
 bool PaStream::play()
 {
+    return setCorked(false);
+}
+
+bool PaStream::pause()
+{
+    return setCorked(true);
+}
+
+pa_operation *PaStream::requestCork(bool cork, int *success)
+{
+    int ignored = 0;
+    int *result = success ? success : &ignored;
+    *result = 0;
     if (!isValid())
+        return nullptr;
+    PaMainloop::Lock lock(*mContext->getMainloop());
+    int corked = pa_stream_is_corked(mStream);
+    if (corked < 0)
+        return nullptr;
+    if (corked == (cork ? 1 : 0)) {
+        *result = 1;
+        return nullptr;
+    }
+    *result = 100;
+    pa_operation *oper = pa_stream_cork(mStream, cork ? 1 : 0, success ? rt_pa_stream_success_cb : nullptr, success);
+    if (!oper)
+        *result = 0;
+    return oper;
+}
+
+bool PaStream::setCorked(bool cork)
+{
+    auto loop = mContext ? mContext->getMainloop() : nullptr;
+    if (!loop)
         return false;
-    auto loop = mContext->getMainloop();
-    if (!loop) {
+    PaMainloop::Lock lock(*loop);
+    int success = 0;
+    pa_operation *oper = requestCork(cork, &success);
+    if (!oper)
+        return success == 1;
+    loop->runUntil([&]() { return success != 100 || mContext->hasError(); });
+    PaMainloop::releaseOperation(oper);
+    return success == 1;
+}
+
+bool PaStream::drain()
+{
+    if (!isValid() || mInput)
         return false;
-    }
+    PaMainloop::Lock lock(*mContext->getMainloop());
+    int success = 100;
+    return runOperation(pa_stream_drain(mStream, rt_pa_stream_success_cb, &success), success);
+}
 
-    int corked = pa_stream_is_corked(mStream);
-    if (corked < 0)
+bool PaStream::flush()
+{
+    if (!isValid())
         return false;
-    if (corked == 0)
-        return true;
+    PaMainloop::Lock lock(*mContext->getMainloop());
     int success = 100;
-    pa_operation *oper = pa_stream_cork(mStream, 0, rt_pa_stream_success_cb, &success);
+    return runOperation(pa_stream_flush(mStream, rt_pa_stream_success_cb, &success), success);
+}
+
+pa_operation *PaStream::requestDrain(int *success)
+{
+    if (!isValid() || mInput)
+        return nullptr;
+    PaMainloop::Lock lock(*mContext->getMainloop());
+    return pa_stream_drain(mStream, success ? rt_pa_stream_success_cb : nullptr, success);
+}
+
+pa_operation *PaStream::requestFlush(int *success)
+{
+    if (!isValid())
+        return nullptr;
+    PaMainloop::Lock lock(*mContext->getMainloop());
+    return pa_stream_flush(mStream, success ? rt_pa_stream_success_cb : nullptr, success);
+}
+
+bool PaStream::setBufferAttr(pa_buffer_attr bufAttr)
+{
+    if (!isValid())
+        return false;
+    PaMainloop::Lock lock(*mContext->getMainloop());
+    int success = 100;
+    if (runOperation(pa_stream_set_buffer_attr(mStream, &bufAttr, rt_pa_stream_success_cb, &success),
+                     success)
+        == false)
+        return false;
+    storeBufferAttr(bufAttr);
+    return true;
+}
+
+void PaStream::storeBufferAttr(const pa_buffer_attr &requested)
+{
+    // The server may round or clamp the requested metrics.
+    const pa_buffer_attr *granted = pa_stream_get_buffer_attr(mStream);
+    mBufferAttr = granted ? *granted : requested;
+}
+
+bool PaStream::requestBufferAttr(pa_buffer_attr bufAttr)
+{
+    if (!isValid())
+        return false;
+    PaMainloop::Lock lock(*mContext->getMainloop());
+    pa_operation *oper = pa_stream_set_buffer_attr(mStream, &bufAttr, nullptr, nullptr);
     if (!oper)
         return false;
-    loop->runUntil([&]() { return success != 100 || mContext->hasError(); });
     pa_operation_unref(oper);
-    if (success == 1)
-        return true;
-    return false;
+    mBufferAttr = bufAttr;
+    return true;
 }
 
-bool PaStream::pause()
+bool PaStream::updateSampleRate(uint32_t rate)
 {
-    if (!isValid())
+    if (!isValid() || !mVariableRate)
         return false;
+    PaMainloop::Lock lock(*mContext->getMainloop());
+    int success = 100;
+    return runOperation(pa_stream_update_sample_rate(mStream, rate, rt_pa_stream_success_cb, &success),
+                        success);
+}
+
+bool PaStream::runOperation(pa_operation *oper, int &success)
+{
     auto loop = mContext->getMainloop();
-    if (!loop) {
+    if (!loop || !oper)
         return false;
-    }
+    loop->runUntil([&]() { return success != 100 || hasError() || mContext->hasError(); });
+    PaMainloop::releaseOperation(oper);
+    return success == 1;
+}
 
-    int corked = pa_stream_is_corked(mStream);
-    if (corked < 0)
+bool PaStream::getLatency(pa_usec_t *usec) const
+{
+    if (!isValid())
         return false;
-    if (corked == 1)
-        return true;
-    int success = 100;
-    pa_operation *oper = pa_stream_cork(mStream, 1, rt_pa_stream_success_cb, &success);
-    if (!oper)
+    int negative = 0;
+    if (pa_stream_get_latency(mStream, usec, &negative) != 0)
         return false;
-    loop->runUntil([&]() { return success != 100 || mContext->hasError(); });
-    pa_operation_unref(oper);
-    if (success == 1)
-        return true;
-    return false;
+    // Record streams read ahead of the capture after an overflow.
+    if (negative)
+        *usec = 0;
+    return true;
 }
 
 void PaStream::setStreamRequest(std::function<void(size_t)> req)
@@ -197,6 +322,35 @@ void PaStream::setStreamRequest(std::function<void(size_t)> req)
     mStreamRequest = req;
 }
 
+void PaStream::setUnderflowCallback(std::function<void()> clb)
+{
+    mUnderflowCallback = clb;
+}
+
+void PaStream::setOverflowCallback(std::function<void()> clb)
+{
+    mOverflowCallback = clb;
+}
+
+void PaStream::setFailureCallback(std::function<void()> clb)
+{
+    mFailureCallback = clb;
+}
+
+void PaStream::streamUnderflow(pa_stream *p)
+{
+    assert(mStream == p);
+    if (mUnderflowCallback)
+        mUnderflowCallback();
+}
+
+void PaStream::streamOverflow(pa_stream *p)
+{
+    assert(mStream == p);
+    if (mOverflowCallback)
+        mOverflowCallback();
+}
+
 bool PaStream::writeData(const void *data, size_t nbytes)
 {
     if (!isValid())
@@ -214,6 +368,28 @@ bool PaStream::writeData(const void *data, size_t nbytes)
     return true;
 }
 
+void *PaStream::beginWrite(size_t nbytes)
+{
+    if (!isValid() || mInput || nbytes == 0)
+        return nullptr;
+    void *data = nullptr;
+    size_t granted = nbytes;
+    if (pa_stream_begin_write(mStream, &data, &granted) != 0 || !data)
+        return nullptr;
+    if (granted < nbytes) {
+        // A partial block would split the period, the caller falls back to a copy.
+        pa_stream_cancel_write(mStream);
+        return nullptr;
+    }
+    return data;
+}
+
+void PaStream::cancelWrite()
+{
+    if (isValid())
+        pa_stream_cancel_write(mStream);
+}
+
 size_t PaStream::peakData(const void **data)
 {
     size_t nbytes = 0;
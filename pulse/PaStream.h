@@ -6,6 +6,7 @@
 #include <pulse/sample.h>
 
 struct pa_stream;
+struct pa_operation;
 class PaContext;
 
 class PaStream
@@ -15,30 +16,70 @@ public:
              const char *streamName,
              pa_sample_spec ss,
              pa_channel_map map);
-    bool connect(const char *dev, pa_buffer_attr bufAttr, bool input);
+    bool connect(const char *dev, pa_buffer_attr bufAttr, bool input, bool variableRate = false);
     ~PaStream();
     bool isValid() const;
 
     void setState(pa_stream *stream);
     void streamRequest(pa_stream *p, size_t nbytes);
     bool hasError() const;
+    // The control methods take the mainloop lock themselves, the data
+    // methods are meant for the request callbacks, which already hold it.
     bool play();
     bool pause();
+    // Starts corking or uncorking without waiting for the server, so the
+    // streams of one context change their state together. Returns nullptr
+    // with success set to 1 if the stream already is in that state,
+    // success may be null if the result does not matter.
+    pa_operation *requestCork(bool cork, int *success);
+    bool drain();
+    bool flush();
+    // Like requestCork(), success may be null if the result does not matter.
+    pa_operation *requestDrain(int *success);
+    pa_operation *requestFlush(int *success);
+    bool setBufferAttr(pa_buffer_attr bufAttr);
+    // Does not wait for the server, safe to call from mainloop callbacks.
+    bool requestBufferAttr(pa_buffer_attr bufAttr);
+    pa_buffer_attr getBufferAttr() const { return mBufferAttr; }
+    bool updateSampleRate(uint32_t rate);
+    bool isVariableRate() const { return mVariableRate; }
     void setStreamRequest(std::function<void(size_t)> req);
+    // The server raises both for playback streams only: underflow when it
+    // ran out of data, overflow when more was written than fits.
+    void setUnderflowCallback(std::function<void()> clb);
+    void setOverflowCallback(std::function<void()> clb);
+    // Called once when the stream fails, was moved or its context died.
+    void setFailureCallback(std::function<void()> clb);
+    void streamUnderflow(pa_stream *p);
+    void streamOverflow(pa_stream *p);
     bool writeData(const void *data, size_t nbytes);
+    // Server memory for exactly nbytes of playback, or nullptr if the server
+    // offers less. Passing it to writeData() hands it over without a copy.
+    void *beginWrite(size_t nbytes);
+    void cancelWrite();
     size_t peakData(const void **data);
     bool dropData();
+    // Time until written data is played or since read data was recorded,
+    // interpolated between the automatic timing updates of the server.
+    bool getLatency(pa_usec_t *usec) const;
 
 private:
+    bool setCorked(bool cork);
     bool tryToMoveBack();
+    void storeBufferAttr(const pa_buffer_attr &requested);
+    bool runOperation(pa_operation *oper, int &success);
     std::shared_ptr<PaContext> mContext;
     pa_stream *mStream = nullptr;
     pa_stream_state mState = PA_STREAM_UNCONNECTED;
     std::function<void(size_t)> mStreamRequest = nullptr;
+    std::function<void()> mUnderflowCallback = nullptr;
+    std::function<void()> mOverflowCallback = nullptr;
+    std::function<void()> mFailureCallback = nullptr;
     std::string mDeviceBusId;
 
     pa_buffer_attr mBufferAttr;
-    bool mInput;
+    bool mInput = false;
+    bool mVariableRate = false;
     int mMoveSuccess = 1;
     bool mStreamMoved = false;
 };
@@ -2,6 +2,7 @@
 #include "pulse/PaContext.h"
 #include "pulse/PaMainloop.h"
 #include <cassert>
+#include <type_traits>
 #include <pulse/context.h>
 #include <pulse/introspect.h>
 #include <pulse/mainloop.h>
@@ -60,29 +61,6 @@ RtAudio::DeviceInfo rtPaSetInfo(const ServerInfoStruct &serverInfo,
     return info;
 }
 
-void rt_pa_set_sink_info_cb2(pa_context * /*c*/, const pa_sink_info *i, int eol, void *userdata)
-{
-    assert(userdata);
-    if (eol) {
-        return;
-    }
-    auto *devicesStruct = reinterpret_cast<ServerDevicesStruct *>(userdata);
-    if (!i) {
-        return;
-    }
-    if (i->card == PA_INVALID_INDEX) {
-        return;
-    }
-
-    auto info = rtPaSetInfo(devicesStruct->serverInfo,
-                            i->sample_spec.channels,
-                            true,
-                            i->description,
-                            i->name);
-
-    devicesStruct->devices.push_back(std::move(info));
-}
-
 void rt_pa_sink_info_card_cb(pa_context *c, const pa_sink_info *i, int eol, void *userdata)
 {
     assert(userdata);
@@ -100,28 +78,6 @@ void rt_pa_sink_info_card_cb(pa_context *c, const pa_sink_info *i, int eol, void
     devicesStruct->card = i->card;
 }
 
-static void rt_pa_set_source_info_cb_and_quit2(pa_context * /*c*/,
-                                               const pa_source_info *i,
-                                               int eol,
-                                               void *userdata)
-{
-    assert(userdata);
-    auto *devicesStruct = reinterpret_cast<ServerDevicesStruct *>(userdata);
-    if (eol) {
-        devicesStruct->setReady();
-        return;
-    }
-    if (!i) {
-        return;
-    }
-    auto info = rtPaSetInfo(devicesStruct->serverInfo,
-                            i->sample_spec.channels,
-                            false,
-                            i->description,
-                            i->name);
-    devicesStruct->devices.push_back(std::move(info));
-}
-
 void rt_pa_card_info_cb(pa_context *c, const pa_card_info *i, int eol, void *userdata)
 {
     assert(userdata);
@@ -144,6 +100,7 @@ void rt_pa_card_info_cb(pa_context *c, const pa_card_info *i, int eol, void *use
 
 uint32_t getSinkCardId(std::shared_ptr<PaContext> context, std::string busId)
 {
+    PaMainloop::Lock lock(*context->getMainloop());
     SinkSourceCardInfo devicesStruct{};
     pa_operation *oper = pa_context_get_sink_info_by_name(context->handle(),
                                                           busId.c_str(),
@@ -153,6 +110,7 @@ uint32_t getSinkCardId(std::shared_ptr<PaContext> context, std::string busId)
         return PA_INVALID_INDEX;
     context->getMainloop()->runUntil(
         [&]() { return devicesStruct.isReady() || context->hasError(); });
+    PaMainloop::releaseOperation(oper);
     return devicesStruct.card;
 }
 
@@ -175,10 +133,13 @@ struct RtPaSinkInfoCallbackUserdata : public OpaqueResultError
         inf.description = i->description;
         inf.driver = i->driver;
         inf.card = i->card;
-        if (typeid(T) == typeid(pa_sink_info)) {
+        inf.channels = i->sample_spec.channels;
+        inf.format = i->sample_spec.format;
+        if constexpr (std::is_same_v<T, pa_sink_info>) {
             inf.type = PulseSinkSourceType::SINK;
-        } else if (typeid(T) == typeid(pa_source_info)) {
+        } else if constexpr (std::is_same_v<T, pa_source_info>) {
             inf.type = PulseSinkSourceType::SOURCE;
+            inf.monitor = i->monitor_of_sink != PA_INVALID_INDEX;
         } else {
             return false;
         }
@@ -222,6 +183,27 @@ void rt_pa_source_info_cb(pa_context *c, const pa_source_info *i, int eol, void
     auto *ud = reinterpret_cast<RtPaSinkInfoCallbackUserdata *>(userdata);
     ud->addInfo(i, eol);
 }
+
+bool addSinkSourceInfoTask(std::shared_ptr<PaContext> context,
+                           pa_operation *oper,
+                           std::shared_ptr<RtPaSinkInfoCallbackUserdata> userd,
+                           std::function<void(std::optional<PulseSinkSourceInfo>)> result)
+{
+    if (!oper)
+        return false;
+    std::shared_ptr<PaMainloopTask> task = std::make_shared<PaMainloopTask>(
+        oper, std::move(userd), [result](std::shared_ptr<OpaqueResultError> res) {
+            auto *ud = static_cast<RtPaSinkInfoCallbackUserdata *>(res.get());
+            auto infos = ud->getInfos();
+            if (infos.size() != 1) {
+                result({});
+            } else {
+                result(infos[0]);
+            }
+        });
+    context->getMainloop()->addTask(std::move(task));
+    return true;
+}
 } // namespace
 
 std::optional<ServerInfoStruct> getServerInfo(std::shared_ptr<PaContext> context)
@@ -232,49 +214,14 @@ std::optional<ServerInfoStruct> getServerInfo(std::shared_ptr<PaContext> context
     if (!loop)
         return {};
 
+    PaMainloop::Lock lock(*loop);
     ServerInfoStruct res{};
     pa_operation *o = pa_context_get_server_info(context->handle(), rt_pa_set_server_info_cb2, &res);
     if (!o) {
         return {};
     }
     loop->runUntil([&]() { return res.isReady() || context->hasError(); });
-    pa_operation_unref(o);
-    if (res.isReady() == false) {
-        return {};
-    }
-    return res;
-}
-
-std::optional<ServerDevicesStruct> getServerDevices(std::shared_ptr<PaContext> context)
-{
-    if (!context)
-        return {};
-    auto loop = context->getMainloop();
-    if (!loop)
-        return {};
-    auto serverInfo_opt = getServerInfo(context);
-    if (!serverInfo_opt)
-        return {};
-
-    ServerDevicesStruct res;
-    res.serverInfo = serverInfo_opt.value();
-    pa_operation *operSinks = pa_context_get_sink_info_list(context->handle(),
-                                                            rt_pa_set_sink_info_cb2,
-                                                            &res);
-    pa_operation *operSources = pa_context_get_source_info_list(context->handle(),
-                                                                rt_pa_set_source_info_cb_and_quit2,
-                                                                &res);
-
-    if (operSinks && operSources) {
-        loop->runUntil([&]() { return res.isReady() || context->hasError(); });
-    }
-
-    if (operSinks) {
-        pa_operation_unref(operSinks);
-    }
-    if (operSources) {
-        pa_operation_unref(operSources);
-    }
+    PaMainloop::releaseOperation(o);
     if (res.isReady() == false) {
         return {};
     }
@@ -283,6 +230,7 @@ std::optional<ServerDevicesStruct> getServerDevices(std::shared_ptr<PaContext> c
 
 std::string getProfileNameForSink(std::shared_ptr<PaContext> context, std::string busId)
 {
+    PaMainloop::Lock lock(*context->getMainloop());
     auto card = getSinkCardId(context, busId);
     if (card == PA_INVALID_INDEX) {
         return {};
@@ -295,7 +243,7 @@ std::string getProfileNameForSink(std::shared_ptr<PaContext> context, std::strin
     if (!oper)
         return {};
     context->getMainloop()->runUntil([&]() { return profile.isReady() || context->hasError(); });
-    pa_operation_unref(oper);    
+    PaMainloop::releaseOperation(oper);
     return profile.profile;
 }
 
@@ -310,6 +258,7 @@ std::optional<PulseSinkSourceInfo> getSinkSourceInfo(std::shared_ptr<PaContext>
                                                      std::string deviceId,
                                                      PulseSinkSourceType type)
 {
+    PaMainloop::Lock lock(*context->getMainloop());
     RtPaSinkInfoCallbackUserdata userd;
 
     pa_operation *oper = nullptr;
@@ -330,7 +279,7 @@ std::optional<PulseSinkSourceInfo> getSinkSourceInfo(std::shared_ptr<PaContext>
         auto state = pa_operation_get_state(oper);
         return userd.isReady() || context->hasError() || state != PA_OPERATION_RUNNING;
     });
-    pa_operation_unref(oper);
+    PaMainloop::releaseOperation(oper);
     auto infos = userd.getInfos();
     if (infos.size() != 1) {
         return {};
@@ -344,6 +293,7 @@ bool getSinkSourceInfoAsync(std::shared_ptr<PaContext> context,
                             PulseSinkSourceType type,
                             std::function<void(std::optional<PulseSinkSourceInfo>)> result)
 {
+    PaMainloop::Lock lock(*context->getMainloop());
     std::shared_ptr<RtPaSinkInfoCallbackUserdata> userd
         = std::make_shared<RtPaSinkInfoCallbackUserdata>();
 
@@ -359,25 +309,119 @@ bool getSinkSourceInfoAsync(std::shared_ptr<PaContext> context,
                                                    rt_pa_source_info_cb,
                                                    userd.get());
     }
-    if (!oper)
+    return addSinkSourceInfoTask(context, oper, std::move(userd), std::move(result));
+}
+
+bool getSinkSourceInfoAsync(std::shared_ptr<PaContext> context,
+                            std::string deviceId,
+                            PulseSinkSourceType type,
+                            std::function<void(std::optional<PulseSinkSourceInfo>)> result)
+{
+    PaMainloop::Lock lock(*context->getMainloop());
+    std::shared_ptr<RtPaSinkInfoCallbackUserdata> userd
+        = std::make_shared<RtPaSinkInfoCallbackUserdata>();
+
+    pa_operation *oper = nullptr;
+    if (type == PulseSinkSourceType::SINK) {
+        oper = pa_context_get_sink_info_by_name(context->handle(),
+                                                deviceId.c_str(),
+                                                rt_pa_sink_info_cb,
+                                                userd.get());
+    } else {
+        oper = pa_context_get_source_info_by_name(context->handle(),
+                                                  deviceId.c_str(),
+                                                  rt_pa_source_info_cb,
+                                                  userd.get());
+    }
+    return addSinkSourceInfoTask(context, oper, std::move(userd), std::move(result));
+}
+
+std::optional<std::vector<PulseSinkSourceInfo>> getSinksAndSources(std::shared_ptr<PaContext> context)
+{
+    PaMainloop::Lock lock(*context->getMainloop());
+    RtPaSinkInfoCallbackUserdata sinks;
+    RtPaSinkInfoCallbackUserdata sources;
+    pa_operation *operSinks = pa_context_get_sink_info_list(context->handle(), rt_pa_sink_info_cb, &sinks);
+    pa_operation *operSources = pa_context_get_source_info_list(context->handle(),
+                                                                rt_pa_source_info_cb,
+                                                                &sources);
+    if (operSinks && operSources) {
+        context->getMainloop()->runUntil(
+            [&]() { return (sinks.isReady() && sources.isReady()) || context->hasError(); });
+    }
+    PaMainloop::releaseOperation(operSinks);
+    PaMainloop::releaseOperation(operSources);
+    if (sinks.isReady() == false || sources.isReady() == false)
         return {};
+    auto devices = sinks.getInfos();
+    auto sourceInfos = sources.getInfos();
+    devices.insert(devices.end(), sourceInfos.begin(), sourceInfos.end());
+    return devices;
+}
 
-    std::shared_ptr<PaMainloopTask> task = std::make_shared<PaMainloopTask>(
-        oper, std::move(userd), [result](std::shared_ptr<OpaqueResultError> res) {
-            auto *ud = dynamic_cast<RtPaSinkInfoCallbackUserdata *>(res.get());
-            assert(ud);
-            if (!ud) {
-                result({});
-            }
-            auto infos = ud->getInfos();
-            if (infos.size() != 1) {
+bool getServerInfoAsync(std::shared_ptr<PaContext> context,
+                        std::function<void(std::optional<ServerInfoStruct>)> result)
+{
+    PaMainloop::Lock lock(*context->getMainloop());
+    auto info = std::make_shared<ServerInfoStruct>();
+    pa_operation *oper = pa_context_get_server_info(context->handle(), rt_pa_set_server_info_cb2, info.get());
+    if (!oper)
+        return false;
+    context->getMainloop()->addTask(
+        std::make_shared<PaMainloopTask>(oper, std::move(info), [result](std::shared_ptr<OpaqueResultError> res) {
+            auto *serverInfo = static_cast<ServerInfoStruct *>(res.get());
+            if (serverInfo->isReady())
+                result(*serverInfo);
+            else
                 result({});
-            } else {
-                result(infos[0]);
-            }
-        });
-    context->getMainloop()->addTask(std::move(task));
+        }));
     return true;
 }
 
+RtAudio::DeviceInfo makeDeviceInfo(const ServerInfoStruct &serverInfo, const PulseSinkSourceInfo &device)
+{
+    RtAudio::DeviceInfo info = rtPaSetInfo(serverInfo,
+                                           device.channels,
+                                           device.type == PulseSinkSourceType::SINK,
+                                           device.description,
+                                           device.name);
+    // Streams run at the device format, other formats are converted by RtAudio.
+    if (RtAudioFormat native = getRtFormatByPulse(device.format))
+        info.nativeFormats = native;
+    return info;
+}
+
+pa_buffer_attr makeBufferAttr(RtApi::StreamMode mode, unsigned int bufferBytes, unsigned int buffersCount)
+{
+    pa_buffer_attr buffer_attr{};
+    buffer_attr.minreq = -1;
+    buffer_attr.prebuf = -1;
+    buffer_attr.tlength = -1;
+    buffer_attr.fragsize = -1;
+
+    if (mode == RtApi::INPUT) {
+        buffer_attr.fragsize = bufferBytes;
+        buffer_attr.maxlength = bufferBytes * buffersCount;
+    } else if (mode == RtApi::OUTPUT) {
+        // The server defaults are sized for desktop use and give far more
+        // latency than the requested buffers. Playback starts once the whole
+        // target is queued and is topped up period by period. maxlength is
+        // left to the server, a zero maxlength would cap the target.
+        buffer_attr.maxlength = -1;
+        buffer_attr.tlength = bufferBytes * buffersCount;
+        buffer_attr.minreq = bufferBytes;
+        buffer_attr.prebuf = buffer_attr.tlength;
+    }
+    return buffer_attr;
+}
+
+unsigned long configuredLatencyFrames(RtApi::StreamMode mode, const pa_buffer_attr &attr, unsigned int frameBytes)
+{
+    if (frameBytes == 0)
+        return 0;
+    // The attributes the server granted, never the "server default" marker.
+    assert(mode == RtApi::INPUT || (attr.tlength != (uint32_t)-1 && attr.tlength <= attr.maxlength));
+    return (mode == RtApi::INPUT ? attr.fragsize : attr.tlength) / frameBytes;
+}
+
 } // namespace PulseCommon
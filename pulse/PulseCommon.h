@@ -4,6 +4,7 @@
 #include "RtAudio.h"
 #include <algorithm>
 #include <array>
+#include <pulse/def.h>
 #include <pulse/sample.h>
 
 struct pa_mainloop;
@@ -37,6 +38,22 @@ constexpr pa_sample_format_t getPulseFormatByRt(RtAudioFormat rtf)
     return it->pa_format;
 }
 
+// Stream format that matches what the sink or source runs at, 0 if there
+// is none. 24 bit samples in 32 bit words are handled as SINT32, which the
+// server turns into the device format by dropping the low byte.
+constexpr RtAudioFormat getRtFormatByPulse(pa_sample_format_t pf)
+{
+    if (pf == PA_SAMPLE_S24_32LE)
+        return RTAUDIO_SINT32;
+    auto it = std::ranges::find(pulse_supported_sampleformats,
+                                pf,
+                                &rtaudio_pa_format_mapping_t::pa_format);
+    if (it == pulse_supported_sampleformats.end()) {
+        return 0;
+    }
+    return it->rtaudio_format;
+}
+
 struct OpaqueResultError
 {
 public:
@@ -54,14 +71,7 @@ struct ServerInfoStruct : public OpaqueResultError
     std::string defaultSourceName;
 };
 
-struct ServerDevicesStruct : public OpaqueResultError
-{
-    std::vector<RtAudio::DeviceInfo> devices;
-    ServerInfoStruct serverInfo;
-};
-
 std::optional<ServerInfoStruct> getServerInfo(std::shared_ptr<PaContext> context);
-std::optional<ServerDevicesStruct> getServerDevices(std::shared_ptr<PaContext> context);
 std::string getProfileNameForSink(std::shared_ptr<PaContext> context, std::string busId);
 
 namespace PulseCommon {
@@ -73,5 +83,23 @@ bool getSinkSourceInfoAsync(std::shared_ptr<PaContext> context,
                             uint32_t id,
                             PulseSinkSourceType type,
                             std::function<void(std::optional<PulseSinkSourceInfo>)> result);
+bool getSinkSourceInfoAsync(std::shared_ptr<PaContext> context,
+                            std::string deviceId,
+                            PulseSinkSourceType type,
+                            std::function<void(std::optional<PulseSinkSourceInfo>)> result);
+
+// Every sink followed by every source of the server.
+std::optional<std::vector<PulseSinkSourceInfo>> getSinksAndSources(std::shared_ptr<PaContext> context);
+
+// The result is passed on the event thread once the server answered.
+bool getServerInfoAsync(std::shared_ptr<PaContext> context,
+                        std::function<void(std::optional<ServerInfoStruct>)> result);
+
+RtAudio::DeviceInfo makeDeviceInfo(const ServerInfoStruct &serverInfo, const PulseSinkSourceInfo &device);
+
+// Server buffer metrics for a stream of buffersCount periods of bufferBytes each.
+pa_buffer_attr makeBufferAttr(RtApi::StreamMode mode, unsigned int bufferBytes, unsigned int buffersCount);
+// Latency the server agreed to in frames, used until timing updates arrive.
+unsigned long configuredLatencyFrames(RtApi::StreamMode mode, const pa_buffer_attr &attr, unsigned int frameBytes);
 
 } // namespace PulseCommon
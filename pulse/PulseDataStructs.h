@@ -1,4 +1,5 @@
 #pragma once
+#include <pulse/sample.h>
 #include <string>
 #include <vector>
 
@@ -38,6 +39,9 @@ struct PulseSinkSourceInfo
     std::string description;
     std::string driver;
     uint32_t card = 0;
+    unsigned int channels = 0;
+    pa_sample_format_t format = PA_SAMPLE_INVALID;
     std::vector<PulsePortInfo> ports;
     PulseSinkSourceType type;
+    bool monitor = false; // Source recording the output of a sink.
 };
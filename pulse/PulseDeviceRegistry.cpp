@@ -0,0 +1,288 @@
+#include "PulseDeviceRegistry.h"
+#include "PaContextWithMainloop.h"
+#include "pulse/PaContext.h"
+#include "pulse/PaMainloop.h"
+#include <algorithm>
+#include <mutex>
+#include <pulse/subscribe.h>
+
+namespace {
+std::mutex sharedRegistryMutex;
+std::weak_ptr<PulseDeviceRegistry> sharedRegistry;
+
+bool isListed(const PulseSinkSourceInfo &info)
+{
+    // Sinks without a card, like null sinks, are not offered as devices.
+    return info.type == PulseSinkSourceType::SOURCE || info.card != PA_INVALID_INDEX;
+}
+
+bool samePorts(const std::vector<PulsePortInfo> &a, const std::vector<PulsePortInfo> &b)
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const PulsePortInfo &x, const PulsePortInfo &y) {
+        return x.name == y.name && x.desc == y.desc && x.priority == y.priority && x.available == y.available
+               && x.active == y.active;
+    });
+}
+
+bool sameDevice(const PulseSinkSourceInfo &a, const PulseSinkSourceInfo &b)
+{
+    // Volume and mute changes are reported as changes too, they do not
+    // touch anything a device info is made of.
+    return a.name == b.name && a.description == b.description && a.driver == b.driver && a.card == b.card
+           && a.channels == b.channels && a.format == b.format && a.monitor == b.monitor
+           && samePorts(a.ports, b.ports);
+}
+} // namespace
+
+std::shared_ptr<PulseDeviceRegistry> PulseDeviceRegistry::GetShared()
+{
+    std::lock_guard<std::mutex> guard(sharedRegistryMutex);
+    auto registry = sharedRegistry.lock();
+    if (registry && registry->hasError() == false)
+        return registry;
+    auto connection = PaContextWithMainloop::GetShared();
+    if (!connection)
+        return {};
+    registry = std::shared_ptr<PulseDeviceRegistry>(new PulseDeviceRegistry(connection));
+    if (registry->populate() == false)
+        return {};
+    sharedRegistry = registry;
+    return registry;
+}
+
+std::shared_ptr<PulseDeviceRegistry> PulseDeviceRegistry::Renew(std::shared_ptr<PulseDeviceRegistry> &held)
+{
+    if (!held || held->hasError())
+        held = GetShared();
+    return held;
+}
+
+PulseDeviceRegistry::PulseDeviceRegistry(std::shared_ptr<PaContextWithMainloop> connection)
+    : mConnection(connection)
+{}
+
+PulseDeviceRegistry::~PulseDeviceRegistry()
+{
+    PaMainloop::Lock lock(*mConnection->getMainloop());
+    *mAlive = false;
+    if (mSubscriberId)
+        mConnection->removeSubscriber(mSubscriberId);
+}
+
+bool PulseDeviceRegistry::populate()
+{
+    // Subscribed first: the server answers in order, so an event either
+    // precedes the lists and is contained in them or follows them.
+    PaMainloop::Lock lock(*mConnection->getMainloop());
+    mSubscriberId = mConnection->addSubscriber(
+        [this](pa_subscription_event_type_t t, uint32_t idx) { handleEvent(t, idx); });
+    if (mSubscriberId == 0)
+        return false;
+    auto context = mConnection->getContext();
+    auto serverInfo = ::getServerInfo(context);
+    auto devices = PulseCommon::getSinksAndSources(context);
+    if (!serverInfo || !devices)
+        return false;
+    mServerInfo = std::move(*serverInfo);
+    for (auto &device : *devices)
+        storeDevice(std::move(device));
+    return true;
+}
+
+bool PulseDeviceRegistry::hasError() const
+{
+    return mConnection->getContext()->hasError();
+}
+
+ServerInfoStruct PulseDeviceRegistry::getServerInfo() const
+{
+    PaMainloop::Lock lock(*mConnection->getMainloop());
+    return mServerInfo;
+}
+
+std::vector<RtAudio::DeviceInfo> PulseDeviceRegistry::listDevices() const
+{
+    PaMainloop::Lock lock(*mConnection->getMainloop());
+    std::vector<RtAudio::DeviceInfo> devices;
+    devices.reserve(mOrder.size());
+    for (const DeviceKey &key : mOrder) {
+        const PulseSinkSourceInfo &info = mDevices.at(key);
+        if (isListed(info))
+            devices.push_back(PulseCommon::makeDeviceInfo(mServerInfo, info));
+    }
+    return devices;
+}
+
+std::optional<RtAudio::DeviceInfo> PulseDeviceRegistry::probeDevice(const std::string &busId) const
+{
+    PaMainloop::Lock lock(*mConnection->getMainloop());
+    auto info = findByName(busId);
+    if (!info || isListed(*info) == false)
+        return {};
+    return PulseCommon::makeDeviceInfo(mServerInfo, *info);
+}
+
+std::optional<PulseSinkSourceInfo> PulseDeviceRegistry::findByName(const std::string &name) const
+{
+    PaMainloop::Lock lock(*mConnection->getMainloop());
+    auto it = mDevicesByName.find(name);
+    if (it == mDevicesByName.end())
+        return {};
+    return mDevices.at(it->second);
+}
+
+std::optional<PulseSinkSourceInfo> PulseDeviceRegistry::findByIndex(PulseSinkSourceType type,
+                                                                    uint32_t index) const
+{
+    PaMainloop::Lock lock(*mConnection->getMainloop());
+    auto it = mDevices.find({type, index});
+    if (it == mDevices.end())
+        return {};
+    return it->second;
+}
+
+std::optional<std::pair<std::string, std::string>> PulseDeviceRegistry::findDuplexDevices(
+    const std::string &busId) const
+{
+    PaMainloop::Lock lock(*mConnection->getMainloop());
+    if (busId.empty())
+        return std::make_pair(mServerInfo.defaultSinkName, mServerInfo.defaultSourceName);
+
+    // Devices without a card, like null sinks, have no counterpart.
+    auto it = mDevicesByName.find(busId);
+    if (it == mDevicesByName.end())
+        return {};
+    const PulseSinkSourceInfo &device = mDevices.at(it->second);
+    if (device.card == PA_INVALID_INDEX)
+        return {};
+    for (const DeviceKey &key : mOrder) {
+        const PulseSinkSourceInfo &other = mDevices.at(key);
+        if (other.type == device.type || other.card != device.card || other.monitor)
+            continue;
+        if (device.type == PulseSinkSourceType::SINK)
+            return std::make_pair(device.name, other.name);
+        return std::make_pair(other.name, device.name);
+    }
+    return {};
+}
+
+int PulseDeviceRegistry::addListener(Listener listener)
+{
+    PaMainloop::Lock lock(*mConnection->getMainloop());
+    int id = mNextListenerId++;
+    mListeners.emplace(id, std::move(listener));
+    return id;
+}
+
+void PulseDeviceRegistry::removeListener(int id)
+{
+    // Once this returns the listener is not running and never called again.
+    PaMainloop::Lock lock(*mConnection->getMainloop());
+    mListeners.erase(id);
+}
+
+void PulseDeviceRegistry::handleEvent(pa_subscription_event_type_t t, uint32_t idx)
+{
+    unsigned int facility = t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    unsigned int evt = t & PA_SUBSCRIPTION_EVENT_TYPE_MASK;
+    if (facility == PA_SUBSCRIPTION_EVENT_SERVER) {
+        updateServerInfo();
+        return;
+    }
+    if (facility != PA_SUBSCRIPTION_EVENT_SINK && facility != PA_SUBSCRIPTION_EVENT_SOURCE)
+        return;
+    PulseSinkSourceType type = facility == PA_SUBSCRIPTION_EVENT_SINK ? PulseSinkSourceType::SINK
+                                                                      : PulseSinkSourceType::SOURCE;
+    switch (evt) {
+    case PA_SUBSCRIPTION_EVENT_NEW:
+        updateDevice(type, idx, RtAudioDeviceParam::DEVICE_ADDED);
+        break;
+    case PA_SUBSCRIPTION_EVENT_CHANGE:
+        updateDevice(type, idx, RtAudioDeviceParam::DEVICE_STATE_CHANGED);
+        break;
+    case PA_SUBSCRIPTION_EVENT_REMOVE:
+        removeDevice(type, idx);
+        break;
+    default:
+        break;
+    }
+}
+
+void PulseDeviceRegistry::updateDevice(PulseSinkSourceType type, uint32_t idx, RtAudioDeviceParam param)
+{
+    // The server answers in order, a lookup on its way already covers
+    // this event.
+    DeviceKey key{type, idx};
+    if (mPendingLookups.insert(key).second == false)
+        return;
+    std::shared_ptr<bool> alive = mAlive;
+    PulseCommon::getSinkSourceInfoAsync(mConnection->getContext(),
+                                        idx,
+                                        type,
+                                        [alive, key, param, this](std::optional<PulseSinkSourceInfo> info) {
+                                            if (*alive == false)
+                                                return;
+                                            mPendingLookups.erase(key);
+                                            // Gone again before the server answered.
+                                            if (!info)
+                                                return;
+                                            auto it = mDevices.find(key);
+                                            bool changed = it == mDevices.end() || !sameDevice(it->second, *info);
+                                            std::string name = info->name;
+                                            storeDevice(std::move(*info));
+                                            if (changed)
+                                                notify(name, param);
+                                        });
+}
+
+void PulseDeviceRegistry::removeDevice(PulseSinkSourceType type, uint32_t idx)
+{
+    // A device the registry never knew has no name to report.
+    auto it = mDevices.find({type, idx});
+    if (it == mDevices.end())
+        return;
+    std::string name = it->second.name;
+    mDevicesByName.erase(name);
+    mOrder.erase(std::find(mOrder.begin(), mOrder.end(), it->first));
+    mDevices.erase(it);
+    notify(name, RtAudioDeviceParam::DEVICE_REMOVED);
+}
+
+void PulseDeviceRegistry::updateServerInfo()
+{
+    std::shared_ptr<bool> alive = mAlive;
+    PulseCommon::getServerInfoAsync(mConnection->getContext(),
+                                    [alive, this](std::optional<ServerInfoStruct> info) {
+                                        if (!info || *alive == false)
+                                            return;
+                                        ServerInfoStruct previous = std::move(mServerInfo);
+                                        mServerInfo = std::move(*info);
+                                        if (mServerInfo.defaultSinkName != previous.defaultSinkName)
+                                            notify(mServerInfo.defaultSinkName,
+                                                   RtAudioDeviceParam::DEFAULT_CHANGED);
+                                        if (mServerInfo.defaultSourceName != previous.defaultSourceName)
+                                            notify(mServerInfo.defaultSourceName,
+                                                   RtAudioDeviceParam::DEFAULT_CHANGED);
+                                    });
+}
+
+void PulseDeviceRegistry::storeDevice(PulseSinkSourceInfo info)
+{
+    DeviceKey key{info.type, info.index};
+    auto it = mDevices.find(key);
+    if (it == mDevices.end()) {
+        mOrder.push_back(key);
+    } else if (it->second.name != info.name) {
+        mDevicesByName.erase(it->second.name);
+    }
+    mDevicesByName[info.name] = key;
+    mDevices[key] = std::move(info);
+}
+
+void PulseDeviceRegistry::notify(const std::string &name, RtAudioDeviceParam param)
+{
+    for (auto it = mListeners.begin(); it != mListeners.end();) {
+        auto current = it++;
+        current->second(name, param);
+    }
+}
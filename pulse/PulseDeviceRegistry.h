@@ -0,0 +1,79 @@
+#pragma once
+#include "PulseCommon.h"
+#include "PulseDataStructs.h"
+#include "RtAudio.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <pulse/def.h>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class PaContextWithMainloop;
+
+// Sinks, sources and server defaults of the shared connection. They are
+// read once and kept current from subscription events, so lookups never
+// wait for the server. All members are guarded by the mainloop lock.
+class PulseDeviceRegistry
+{
+public:
+    using Listener = std::function<void(const std::string &name, RtAudioDeviceParam param)>;
+
+    static std::shared_ptr<PulseDeviceRegistry> GetShared();
+    // Keeps a held registry while its connection is alive and replaces it
+    // with the shared one otherwise. Returns held, null on failure.
+    static std::shared_ptr<PulseDeviceRegistry> Renew(std::shared_ptr<PulseDeviceRegistry> &held);
+    ~PulseDeviceRegistry();
+    PulseDeviceRegistry(const PulseDeviceRegistry &) = delete;
+    PulseDeviceRegistry &operator=(const PulseDeviceRegistry &) = delete;
+
+    // True once the connection is gone, the registry is not updated anymore.
+    bool hasError() const;
+
+    ServerInfoStruct getServerInfo() const;
+    // Sinks with a card and all sources, in the order the server reported them.
+    std::vector<RtAudio::DeviceInfo> listDevices() const;
+    std::optional<RtAudio::DeviceInfo> probeDevice(const std::string &busId) const;
+    std::optional<PulseSinkSourceInfo> findByName(const std::string &name) const;
+    std::optional<PulseSinkSourceInfo> findByIndex(PulseSinkSourceType type, uint32_t index) const;
+    // Sink and source of the card a duplex stream uses. busId names either
+    // of them, the server defaults are used for an empty busId.
+    std::optional<std::pair<std::string, std::string>> findDuplexDevices(const std::string &busId) const;
+
+    // Called on the event thread after a device was added, changed or
+    // removed, and when a server default changed. Returns 0 on failure.
+    int addListener(Listener listener);
+    void removeListener(int id);
+
+private:
+    explicit PulseDeviceRegistry(std::shared_ptr<PaContextWithMainloop> connection);
+    bool populate();
+    void handleEvent(pa_subscription_event_type_t t, uint32_t idx);
+    void updateDevice(PulseSinkSourceType type, uint32_t idx, RtAudioDeviceParam param);
+    void removeDevice(PulseSinkSourceType type, uint32_t idx);
+    void updateServerInfo();
+    void storeDevice(PulseSinkSourceInfo info);
+    void notify(const std::string &name, RtAudioDeviceParam param);
+
+    using DeviceKey = std::pair<PulseSinkSourceType, uint32_t>;
+
+    std::shared_ptr<PaContextWithMainloop> mConnection;
+    int mSubscriberId = 0;
+    // Cleared on destruction, lookups still in flight check it.
+    std::shared_ptr<bool> mAlive = std::make_shared<bool>(true);
+
+    ServerInfoStruct mServerInfo;
+    std::map<DeviceKey, PulseSinkSourceInfo> mDevices;
+    // Names are unique across sinks and sources.
+    std::unordered_map<std::string, DeviceKey> mDevicesByName;
+    // Server order of the devices, new ones are appended.
+    std::vector<DeviceKey> mOrder;
+    // Devices with a lookup on its way.
+    std::set<DeviceKey> mPendingLookups;
+
+    std::map<int, Listener> mListeners;
+    int mNextListenerId = 1;
+};
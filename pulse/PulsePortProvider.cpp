@@ -4,26 +4,9 @@
 #include "pulse/PaContext.h"
 #include "pulse/PaMainloop.h"
 #include "pulse/introspect.h"
+#include <algorithm>
 #include <cassert>
-
-PulsePortProvider::PulsePortProvider()
-{
-    mContext = PaContextWithMainloop::Create(nullptr);
-    if (!mContext) {
-        return;
-    }
-}
-
-std::shared_ptr<PulsePortProvider> PulsePortProvider::Create()
-{
-    std::shared_ptr<PulsePortProvider> p = std::shared_ptr<PulsePortProvider>(
-        new PulsePortProvider());
-    if (p->isValid() == false)
-        return {};
-    return p;
-}
-
-PulsePortProvider::~PulsePortProvider() {}
+#include <pulse/subscribe.h>
 
 namespace {
 
@@ -98,128 +81,280 @@ void rt_pa_context_success_cb(pa_context *c, int success, void *userdata)
     r->setReady();
 }
 
-std::optional<PulseCardInfo> getCardInfoPriv(pa_operation *oper,
-                                             std::shared_ptr<PaContext> context,
-                                             RtPaCardInfoUserdata *userd)
+template<class T>
+class RtPaCompletion
 {
-    if (!oper)
-        return {};
-    context->getMainloop()->runUntil([&]() {
-        auto state = pa_operation_get_state(oper);
-        return userd->isReady() || context->hasError() || state != PA_OPERATION_RUNNING;
-    });
-    pa_operation_unref(oper);
-    auto infos = userd->getInfos();
-    if (infos.size() != 1) {
-        return {};
+public:
+    // The failed value is passed if the operation is dropped unanswered,
+    // for example because the connection broke.
+    explicit RtPaCompletion(T failed)
+        : mFailed(std::move(failed))
+    {}
+    ~RtPaCompletion()
+    {
+        if (mDone == false)
+            mPromise.set_value(std::move(mFailed));
     }
-    auto info = infos[0];
-    return info;
+    std::future<T> getFuture() { return mPromise.get_future(); }
+    void complete(T value)
+    {
+        mDone = true;
+        mPromise.set_value(std::move(value));
+    }
+
+private:
+    std::promise<T> mPromise;
+    T mFailed;
+    bool mDone = false;
+};
+
+template<class T>
+std::shared_ptr<RtPaCompletion<T>> makeCompletion(T failed)
+{
+    return std::make_shared<RtPaCompletion<T>>(std::move(failed));
 }
 
 } // namespace
 
+// Card list shared with the subscription and the pending requests, guarded
+// by the mainloop lock. Every card event and profile change bumps the
+// generation, lists requested before that are not kept.
+struct PulsePortProvider::CardCache
+{
+    std::optional<std::vector<PulseCardInfo>> cards;
+    uint64_t generation = 0;
+    bool enabled = false;
+
+    void invalidate()
+    {
+        cards.reset();
+        generation++;
+    }
+};
+
+PulsePortProvider::PulsePortProvider()
+{
+    mContext = PaContextWithMainloop::GetShared();
+    if (!mContext) {
+        return;
+    }
+    mCards = std::make_shared<CardCache>();
+    std::shared_ptr<CardCache> cache = mCards;
+    mSubscriberId = mContext->addSubscriber([cache](pa_subscription_event_type_t t, uint32_t) {
+        if ((t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK) == PA_SUBSCRIPTION_EVENT_CARD)
+            cache->invalidate();
+    });
+    // Without the events nothing would tell the cache that it is stale.
+    mCards->enabled = mSubscriberId != 0;
+}
+
+std::shared_ptr<PulsePortProvider> PulsePortProvider::Create()
+{
+    std::shared_ptr<PulsePortProvider> p = std::shared_ptr<PulsePortProvider>(
+        new PulsePortProvider());
+    if (p->isValid() == false)
+        return {};
+    return p;
+}
+
+PulsePortProvider::~PulsePortProvider()
+{
+    if (mContext && mSubscriberId)
+        mContext->removeSubscriber(mSubscriberId);
+}
+
 std::optional<PulseSinkSourceInfo> PulsePortProvider::getSinkSourceInfo(std::string deviceId,
                                                                         PulseSinkSourceType type)
 {
-    return PulseCommon::getSinkSourceInfo(mContext->getContext(), deviceId, type);
+    if (canWait() == false)
+        return {};
+    return getSinkSourceInfoAsync(std::move(deviceId), type).get();
 }
 
 std::optional<PulseCardInfo> PulsePortProvider::getCardInfoById(uint32_t id)
 {
-    RtPaCardInfoUserdata userd;
-    pa_operation *oper = nullptr;
-    oper = pa_context_get_card_info_by_index(mContext->getContext()->handle(),
-                                             id,
-                                             rt_pa_card_info_cb,
-                                             &userd);
-    return getCardInfoPriv(oper, mContext->getContext(), &userd);
+    if (canWait() == false)
+        return {};
+    return getCardInfoByIdAsync(id).get();
 }
 
 std::optional<PulseCardInfo> PulsePortProvider::getCardInfoByName(std::string card)
 {
-    RtPaCardInfoUserdata userd;
-    pa_operation *oper = nullptr;
-    oper = pa_context_get_card_info_by_name(mContext->getContext()->handle(),
-                                            card.c_str(),
-                                            rt_pa_card_info_cb,
-                                            &userd);
-
-    return getCardInfoPriv(oper, mContext->getContext(), &userd);
+    if (canWait() == false)
+        return {};
+    return getCardInfoByNameAsync(std::move(card)).get();
 }
 
 std::optional<std::vector<PulseCardInfo>> PulsePortProvider::getCards()
 {
-    RtPaCardInfoUserdata userd;
-    pa_operation *oper = pa_context_get_card_info_list(mContext->getContext()->handle(),
-                                                       rt_pa_card_info_cb,
-                                                       &userd);
-    if (!oper)
-        return {};
-    mContext->getContext()->getMainloop()->runUntil([&]() {
-        auto state = pa_operation_get_state(oper);
-        return userd.isReady() || mContext->getContext()->hasError()
-               || state != PA_OPERATION_RUNNING;
-    });
-    if (userd.isReady() == false)
+    if (canWait() == false)
         return {};
-    auto infos = userd.getInfos();
-    return infos;
+    return getCardsAsync().get();
 }
 
 bool PulsePortProvider::setPortForDevice(std::string deviceId,
                                          PulseSinkSourceType type,
                                          std::string portName)
 {
-    RtPaSuccessUserdata userd;
+    if (canWait() == false)
+        return false;
+    return setPortForDeviceAsync(std::move(deviceId), type, std::move(portName)).get();
+}
+
+bool PulsePortProvider::setProfileForCard(std::string card, std::string profile)
+{
+    if (canWait() == false)
+        return false;
+    return setProfileForCardAsync(std::move(card), std::move(profile)).get();
+}
+
+std::future<std::optional<PulseSinkSourceInfo>> PulsePortProvider::getSinkSourceInfoAsync(
+    std::string deviceId, PulseSinkSourceType type)
+{
+    auto completion = makeCompletion<std::optional<PulseSinkSourceInfo>>(std::nullopt);
+    auto future = completion->getFuture();
+    PulseCommon::getSinkSourceInfoAsync(mContext->getContext(),
+                                        std::move(deviceId),
+                                        type,
+                                        [completion](std::optional<PulseSinkSourceInfo> info) {
+                                            completion->complete(std::move(info));
+                                        });
+    return future;
+}
+
+std::future<std::optional<PulseCardInfo>> PulsePortProvider::getCardInfoByIdAsync(uint32_t id)
+{
+    auto completion = makeCompletion<std::optional<PulseCardInfo>>(std::nullopt);
+    auto future = completion->getFuture();
+    fetchCards([completion, id](std::optional<std::vector<PulseCardInfo>> cards) {
+        if (cards) {
+            auto it = std::ranges::find(*cards, id, &PulseCardInfo::index);
+            if (it != cards->end()) {
+                completion->complete(std::move(*it));
+                return;
+            }
+        }
+        completion->complete({});
+    });
+    return future;
+}
+
+std::future<std::optional<PulseCardInfo>> PulsePortProvider::getCardInfoByNameAsync(std::string card)
+{
+    auto completion = makeCompletion<std::optional<PulseCardInfo>>(std::nullopt);
+    auto future = completion->getFuture();
+    fetchCards([completion, card](std::optional<std::vector<PulseCardInfo>> cards) {
+        if (cards) {
+            auto it = std::ranges::find(*cards, card, &PulseCardInfo::name);
+            if (it != cards->end()) {
+                completion->complete(std::move(*it));
+                return;
+            }
+        }
+        completion->complete({});
+    });
+    return future;
+}
+
+std::future<std::optional<std::vector<PulseCardInfo>>> PulsePortProvider::getCardsAsync()
+{
+    auto completion = makeCompletion<std::optional<std::vector<PulseCardInfo>>>(std::nullopt);
+    auto future = completion->getFuture();
+    fetchCards([completion](std::optional<std::vector<PulseCardInfo>> cards) {
+        completion->complete(std::move(cards));
+    });
+    return future;
+}
 
+std::future<bool> PulsePortProvider::setPortForDeviceAsync(std::string deviceId,
+                                                           PulseSinkSourceType type,
+                                                           std::string portName)
+{
+    auto completion = makeCompletion<bool>(false);
+    auto future = completion->getFuture();
+    PaMainloop::Lock lock(*mContext->getMainloop());
+    auto userd = std::make_shared<RtPaSuccessUserdata>();
     pa_operation *oper = nullptr;
     if (type == PulseSinkSourceType::SINK) {
         oper = pa_context_set_sink_port_by_name(mContext->getContext()->handle(),
                                                 deviceId.c_str(),
                                                 portName.c_str(),
                                                 rt_pa_context_success_cb,
-                                                &userd);
+                                                userd.get());
     } else {
         oper = pa_context_set_source_port_by_name(mContext->getContext()->handle(),
                                                   deviceId.c_str(),
                                                   portName.c_str(),
                                                   rt_pa_context_success_cb,
-                                                  &userd);
+                                                  userd.get());
     }
     if (!oper)
-        return false;
-
-    mContext->getContext()->getMainloop()->runUntil([&]() {
-        auto state = pa_operation_get_state(oper);
-        return userd.isReady() || mContext->getContext()->hasError()
-               || state != PA_OPERATION_RUNNING;
-    });
-    pa_operation_unref(oper);
-    if (userd.getResult() == 1)
-        return true;
-    return false;
+        return future;
+    mContext->getMainloop()->addTask(
+        std::make_shared<PaMainloopTask>(oper, std::move(userd), [completion](std::shared_ptr<OpaqueResultError> res) {
+            completion->complete(static_cast<RtPaSuccessUserdata *>(res.get())->getResult() == 1);
+        }));
+    return future;
 }
 
-bool PulsePortProvider::setProfileForCard(std::string card, std::string profile)
+std::future<bool> PulsePortProvider::setProfileForCardAsync(std::string card, std::string profile)
 {
-    RtPaSuccessUserdata userd;
+    auto completion = makeCompletion<bool>(false);
+    auto future = completion->getFuture();
+    PaMainloop::Lock lock(*mContext->getMainloop());
+    // Card lists requested from now on are answered after the change.
+    mCards->invalidate();
+    auto userd = std::make_shared<RtPaSuccessUserdata>();
     pa_operation *oper = pa_context_set_card_profile_by_name(mContext->getContext()->handle(),
                                                              card.c_str(),
                                                              profile.c_str(),
                                                              rt_pa_context_success_cb,
-                                                             &userd);
+                                                             userd.get());
     if (!oper)
-        return false;
-    mContext->getContext()->getMainloop()->runUntil([&]() {
-        auto state = pa_operation_get_state(oper);
-        return userd.isReady() || mContext->getContext()->hasError()
-               || state != PA_OPERATION_RUNNING;
-    });
-    pa_operation_unref(oper);
-    if (userd.getResult() == 1)
-        return true;
-    return false;
+        return future;
+    mContext->getMainloop()->addTask(
+        std::make_shared<PaMainloopTask>(oper, std::move(userd), [completion](std::shared_ptr<OpaqueResultError> res) {
+            completion->complete(static_cast<RtPaSuccessUserdata *>(res.get())->getResult() == 1);
+        }));
+    return future;
+}
+
+void PulsePortProvider::fetchCards(std::function<void(std::optional<std::vector<PulseCardInfo>>)> result)
+{
+    PaMainloop::Lock lock(*mContext->getMainloop());
+    if (mCards->cards) {
+        result(*mCards->cards);
+        return;
+    }
+    auto userd = std::make_shared<RtPaCardInfoUserdata>();
+    pa_operation *oper = pa_context_get_card_info_list(mContext->getContext()->handle(),
+                                                       rt_pa_card_info_cb,
+                                                       userd.get());
+    if (!oper) {
+        result({});
+        return;
+    }
+    std::shared_ptr<CardCache> cache = mCards;
+    uint64_t generation = cache->generation;
+    mContext->getMainloop()->addTask(std::make_shared<PaMainloopTask>(
+        oper, std::move(userd), [cache, generation, result](std::shared_ptr<OpaqueResultError> res) {
+            auto *ud = static_cast<RtPaCardInfoUserdata *>(res.get());
+            if (ud->isReady() == false) {
+                result({});
+                return;
+            }
+            auto cards = ud->getInfos();
+            // A card changed while the list was on its way.
+            if (cache->enabled && cache->generation == generation)
+                cache->cards = cards;
+            result(std::move(cards));
+        }));
+}
+
+bool PulsePortProvider::canWait() const
+{
+    // The futures are completed on the event thread.
+    return mContext->getMainloop()->isEventThread() == false;
 }
 
 bool PulsePortProvider::hasError() const
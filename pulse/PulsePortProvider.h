@@ -1,6 +1,8 @@
 #pragma once
 #include "PulseDataStructs.h"
 #include "RtAudio.h"
+#include <functional>
+#include <future>
 #include <memory>
 #include <optional>
 #include <string>
@@ -24,8 +26,32 @@ public:
     bool setProfileForCard(std::string card, std::string profile);
     bool hasError() const;
 
+    // The requests go out right away and the futures become ready on the
+    // event thread once the server answered. The server answers in order,
+    // so requests issued back to back share one round-trip and are all
+    // done once the future of the last one is. Card data is cached until
+    // a card changes or a profile is set. Do not wait for the futures in
+    // device notifications or stream callbacks.
+    std::future<std::optional<PulseSinkSourceInfo>> getSinkSourceInfoAsync(std::string deviceId,
+                                                                           PulseSinkSourceType type);
+    std::future<std::optional<PulseCardInfo>> getCardInfoByIdAsync(uint32_t id);
+    std::future<std::optional<PulseCardInfo>> getCardInfoByNameAsync(std::string card);
+    std::future<std::optional<std::vector<PulseCardInfo>>> getCardsAsync();
+
+    std::future<bool> setPortForDeviceAsync(std::string deviceId,
+                                            PulseSinkSourceType type,
+                                            std::string portName);
+    std::future<bool> setProfileForCardAsync(std::string card, std::string profile);
+
 private:
-    PulsePortProvider();    
+    struct CardCache;
+
+    PulsePortProvider();
     bool isValid() const;
+    void fetchCards(std::function<void(std::optional<std::vector<PulseCardInfo>>)> result);
+    bool canWait() const;
+
     std::shared_ptr<PaContextWithMainloop> mContext;
+    std::shared_ptr<CardCache> mCards;
+    int mSubscriberId = 0;
 };
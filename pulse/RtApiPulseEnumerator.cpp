@@ -1,7 +1,5 @@
 #include "RtApiPulseEnumerator.h"
-#include "PaContextWithMainloop.h"
-#include "PulseCommon.h"
-#include "pulse/PaContext.h"
+#include "PulseDeviceRegistry.h"
 
 namespace {
 std::vector<RtAudio::DeviceInfoPartial> deviceToPartial(
@@ -17,39 +15,28 @@ std::vector<RtAudio::DeviceInfoPartial> deviceToPartial(
 
 std::vector<RtAudio::DeviceInfoPartial> RtApiPulseEnumerator::listDevices()
 {
-    auto contextWithLoop = PaContextWithMainloop::Create(nullptr);
-    if (!contextWithLoop) {
-        errorStream_ << "RtApiPulse::probeDevices: failed to create context with mainloop.";
+    auto registry = PulseDeviceRegistry::Renew(mRegistry);
+    if (!registry) {
+        errorStream_ << "RtApiPulseEnumerator::listDevices: failed to read the devices of the server.";
         error(RTAUDIO_SYSTEM_ERROR, errorStream_.str());
         return {};
     }
-
-    auto devices = getServerDevices(contextWithLoop->getContext());
-    if (!devices) {
-        errorStream_ << "PaMainloopRunning::run: get devices failed: ";
-        error(RTAUDIO_SYSTEM_ERROR, errorStream_.str());
-        return {};
-    }
-    return deviceToPartial(devices->devices);
+    return deviceToPartial(registry->listDevices());
 }
 
 std::string RtApiPulseEnumerator::getDefaultDevice(RtApi::StreamMode mode)
 {
-    auto contextWithLoop = PaContextWithMainloop::Create(nullptr);
-    if (!contextWithLoop) {
-        errorStream_ << "RtApiPulse::probeDevices: failed to create context with mainloop.";
+    auto registry = PulseDeviceRegistry::Renew(mRegistry);
+    if (!registry) {
+        errorStream_ << "RtApiPulseEnumerator::getDefaultDevice: failed to read the devices of the server.";
         error(RTAUDIO_SYSTEM_ERROR, errorStream_.str());
         return {};
     }
-    auto serverInfo = getServerInfo(contextWithLoop->getContext());
-    if (!serverInfo) {
-        return {};
-    }
-
+    auto serverInfo = registry->getServerInfo();
     if (mode == RtApi::StreamMode::INPUT) {
-        return serverInfo->defaultSourceName;
+        return serverInfo.defaultSourceName;
     } else if (mode == RtApi::StreamMode::OUTPUT) {
-        return serverInfo->defaultSinkName;
+        return serverInfo.defaultSinkName;
     }
     return {};
 }
@@ -4,10 +4,16 @@
 #include "RtAudio.h"
 #include <pulse/pulseaudio.h>
 
+class PulseDeviceRegistry;
+
 class RtApiPulseEnumerator : public RtApiEnumerator
 {
 public:
     RtAudio::Api getCurrentApi(void) override { return RtAudio::LINUX_PULSE; }
     virtual std::vector<RtAudio::DeviceInfoPartial> listDevices(void) override;
     virtual std::string getDefaultDevice(RtApi::StreamMode mode) override;
+
+private:
+    // Held so that repeated calls are answered from memory.
+    std::shared_ptr<PulseDeviceRegistry> mRegistry;
 };
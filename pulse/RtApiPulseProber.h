@@ -4,9 +4,15 @@
 struct pa_mainloop;
 struct pa_context;
 
+class PulseDeviceRegistry;
+
 class RtApiPulseProber : public RtApiProber
 {
 public:
     RtAudio::Api getCurrentApi(void) override { return RtAudio::LINUX_PULSE; }
     std::optional<RtAudio::DeviceInfo> probeDevice(const std::string &busId) override;
+
+private:
+    // Held so that repeated probes are answered from memory.
+    std::shared_ptr<PulseDeviceRegistry> mRegistry;
 };
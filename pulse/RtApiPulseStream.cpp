@@ -3,176 +3,627 @@
 #include "pulse/PaContextWithMainloop.h"
 #include "pulse/PaMainloop.h"
 #include "pulse/PaStream.h"
+#include "pulse/PulseCommon.h"
+#include "LatencyController.h"
+#include "XrunStatistics.h"
 #include <cassert>
+#include <cstring>
+
+namespace {
+// Periods of captured input a duplex stream buffers ahead of the output.
+constexpr unsigned int DUPLEX_INPUT_PERIODS = 2;
+
+// Results of the server operations that end a finished stream.
+struct FinishState : public OpaqueResultError
+{
+    int flushed = 100;
+    int corked[2] = {100, 100};
+};
+} // namespace
 
 RtApiPulseStream::RtApiPulseStream(RtApi::RtApiStream apiStream,
                                    std::shared_ptr<PaContextWithMainloop> contextMainloop,
-                                   std::shared_ptr<PaStream> stream)
+                                   std::shared_ptr<PaStream> stream,
+                                   std::shared_ptr<PaStream> duplexInput)
     : RtApiStreamClass(apiStream)
     , mContextMainloop(contextMainloop)
     , mStream(stream)
-    , mThread([this]() { return threadMethod(); })
+    , mDuplexStream(duplexInput)
 {
-    mStream->setStreamRequest([this](size_t nbytes) { processAudio(nbytes); });
+    // Requests are dispatched on the event thread of the shared connection.
+    PaMainloop::Lock lock(*mContextMainloop->getMainloop());
+    if (stream_.callbackInfo.doRealtime)
+        mRealtimeRequest = mContextMainloop->requestRealtime(stream_.callbackInfo.priority);
+    mStream->setStreamRequest([this](size_t nbytes) {
+        processAudio(nbytes);
+        if (mFinishRequest != 0 && mFinishing == false)
+            finishStream();
+    });
+    mStream->setFailureCallback([this]() { stream_.errorState = true; });
+    // Record streams get no xrun callbacks, their overruns show up as holes
+    // in the captured data. A playback overflow only means the server
+    // dropped data written ahead, there is no gap to report.
+    if (stream_.mode != RtApi::INPUT)
+        mStream->setUnderflowCallback([this]() { processXrun(RTAUDIO_OUTPUT_UNDERFLOW); });
+    if (mDuplexStream) {
+        mDuplexStream->setStreamRequest([this](size_t) { captureDuplexInput(); });
+        mDuplexStream->setFailureCallback([this]() { stream_.errorState = true; });
+    }
+    resizeBlockBuffers();
+    setupLatencyController();
 }
 
 RtApiPulseStream::~RtApiPulseStream()
 {
+    PaMainloop::Lock lock(*mContextMainloop->getMainloop());
     stopStreamPriv();
+    // Disconnected under the lock, no request reaches this object afterwards.
+    mDuplexStream.reset();
+    mStream.reset();
+    if (mRealtimeRequest)
+        mContextMainloop->releaseRealtime(mRealtimeRequest);
 }
 
 RtAudioErrorType RtApiPulseStream::startStream()
 {
+    PaMainloop::Lock lock(*mContextMainloop->getMainloop());
+    if (stream_.state == RtApi::STREAM_WARM) {
+        // Already uncorked, the next request goes to the callback.
+        mCallbackEnabled = true;
+        stream_.state = RtApi::STREAM_RUNNING;
+        return RTAUDIO_NO_ERROR;
+    }
     if (stream_.state != RtApi::STREAM_STOPPED) {
         return RTAUDIO_SYSTEM_ERROR;
     }
-    if (mStream->play() == false) {
+    if (mContextMainloop->getMainloop()->isEventThread()) {
+        return error(RTAUDIO_INVALID_USE, "RtApiPulseStream::startStream: not available in a stream callback.");
+    }
+    mInputBlocks.reset();
+    mOutputCarry.reset();
+    if (setCorked(false) == false) {
         return RTAUDIO_SYSTEM_ERROR;
     }
-    mThread.resume();
+    mCallbackEnabled = true;
     stream_.state = RtApi::STREAM_RUNNING;
     return RTAUDIO_NO_ERROR;
 }
 
 RtAudioErrorType RtApiPulseStream::stopStream()
 {
+    PaMainloop::Lock lock(*mContextMainloop->getMainloop());
+    if (stream_.state == RtApi::STREAM_PAUSED) {
+        // Already corked, forget the buffered data.
+        for (PaStream *stream : {mStream.get(), mDuplexStream.get()}) {
+            pa_operation *oper = stream ? stream->requestFlush(nullptr) : nullptr;
+            if (oper)
+                pa_operation_unref(oper);
+        }
+        stream_.state = RtApi::STREAM_STOPPED;
+        return RTAUDIO_NO_ERROR;
+    }
     return stopStreamPriv();
 }
 
-bool RtApiPulseStream::threadMethod()
+RtAudioErrorType RtApiPulseStream::warmStream()
+{
+    PaMainloop::Lock lock(*mContextMainloop->getMainloop());
+    if (stream_.state == RtApi::STREAM_RUNNING) {
+        mCallbackEnabled = false;
+        stream_.state = RtApi::STREAM_WARM;
+        return RTAUDIO_NO_ERROR;
+    }
+    if (stream_.state != RtApi::STREAM_STOPPED) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    if (mContextMainloop->getMainloop()->isEventThread()) {
+        return error(RTAUDIO_INVALID_USE, "RtApiPulseStream::warmStream: not available in a stream callback.");
+    }
+    mInputBlocks.reset();
+    mOutputCarry.reset();
+    if (setCorked(false) == false) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    mCallbackEnabled = false;
+    stream_.state = RtApi::STREAM_WARM;
+    return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiPulseStream::pauseStream()
 {
-    auto loop = mContextMainloop->getContext()->getMainloop();
-    if (loop->iterateBlocking() == false)
-        return false;
+    PaMainloop::Lock lock(*mContextMainloop->getMainloop());
+    waitForFinish();
+    if (stream_.state != RtApi::STREAM_RUNNING && stream_.state != RtApi::STREAM_WARM) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    mCallbackEnabled = false;
+    mStateBeforePause = stream_.state;
+    if (requestCorked() == false) {
+        stream_.state = RtApi::STREAM_STOPPED;
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    stream_.state = RtApi::STREAM_PAUSED;
+    return RTAUDIO_NO_ERROR;
+}
 
-    bool errorInAudiothread = false;
-    errorInAudiothread = mContextMainloop->getContext()->hasError();
-    errorInAudiothread = errorInAudiothread || mStream->hasError();
-    if (errorInAudiothread) {
-        stream_.errorState = true;
-        return false;
+RtAudioErrorType RtApiPulseStream::resumeStream()
+{
+    PaMainloop::Lock lock(*mContextMainloop->getMainloop());
+    if (stream_.state != RtApi::STREAM_PAUSED) {
+        return RTAUDIO_SYSTEM_ERROR;
     }
-    return true;
+    if (mContextMainloop->getMainloop()->isEventThread()) {
+        return error(RTAUDIO_INVALID_USE, "RtApiPulseStream::resumeStream: not available in a stream callback.");
+    }
+    if (setCorked(false) == false) {
+        return RTAUDIO_SYSTEM_ERROR;
+    }
+    stream_.state = mStateBeforePause;
+    mCallbackEnabled = stream_.state == RtApi::STREAM_RUNNING;
+    return RTAUDIO_NO_ERROR;
+}
+
+RtAudioErrorType RtApiPulseStream::reconfigure(unsigned int bufferSize, unsigned int sampleRate)
+{
+    PaMainloop::Lock lock(*mContextMainloop->getMainloop());
+    if (stream_.state != RtApi::STREAM_STOPPED && stream_.state != RtApi::STREAM_PAUSED) {
+        return error(RTAUDIO_INVALID_USE, "RtApiPulseStream::reconfigure: the stream must be stopped or paused.");
+    }
+    if (mContextMainloop->getMainloop()->isEventThread()) {
+        return error(RTAUDIO_INVALID_USE, "RtApiPulseStream::reconfigure: not available in a stream callback.");
+    }
+    if (bufferSize == 0) {
+        return error(RTAUDIO_INVALID_PARAMETER, "RtApiPulseStream::reconfigure: invalid buffer size.");
+    }
+    if (sampleRate != stream_.sampleRate) {
+        if (mStream->isVariableRate() == false) {
+            return error(RTAUDIO_INVALID_USE,
+                         "RtApiPulseStream::reconfigure: changing the sample rate requires RTAUDIO_VARIABLE_RATE.");
+        }
+        if (std::ranges::find(PULSE_SUPPORTED_SAMPLERATES, sampleRate) == PULSE_SUPPORTED_SAMPLERATES.end()) {
+            return error(RTAUDIO_INVALID_PARAMETER, "RtApiPulseStream::reconfigure: samplerate not supported.");
+        }
+        if (mStream->updateSampleRate(sampleRate) == false
+            || (mDuplexStream && mDuplexStream->updateSampleRate(sampleRate) == false)) {
+            return error(RTAUDIO_SYSTEM_ERROR, "RtApiPulseStream::reconfigure: error updating the sample rate.");
+        }
+    }
+    if (bufferSize != stream_.bufferSize) {
+        for (int mode : {RtApi::OUTPUT, RtApi::INPUT}) {
+            PaStream *paStream = mode == RtApi::INPUT && mDuplexStream ? mDuplexStream.get() : mStream.get();
+            if ((mode == RtApi::OUTPUT && stream_.mode == RtApi::INPUT)
+                || (mode == RtApi::INPUT && stream_.mode == RtApi::OUTPUT))
+                continue;
+            unsigned int bufferBytes = stream_.nDeviceChannels[mode] * bufferSize
+                                       * RtApi::formatBytes(stream_.deviceFormat[mode]);
+            pa_buffer_attr attr = PulseCommon::makeBufferAttr(RtApi::StreamMode(mode), bufferBytes, stream_.nBuffers);
+            if (paStream->setBufferAttr(attr) == false) {
+                return error(RTAUDIO_SYSTEM_ERROR, "RtApiPulseStream::reconfigure: error setting the buffer metrics.");
+            }
+            stream_.latency[mode] = PulseCommon::configuredLatencyFrames(RtApi::StreamMode(mode),
+                                                                         paStream->getBufferAttr(),
+                                                                         bufferBytes / bufferSize);
+        }
+    }
+    if (resizeStreamBuffers(bufferSize, sampleRate) == false) {
+        return RTAUDIO_MEMORY_ERROR;
+    }
+    resizeBlockBuffers();
+    setupLatencyController();
+    return RTAUDIO_NO_ERROR;
+}
+
+void RtApiPulseStream::resizeBlockBuffers()
+{
+    // Capture fragments are collected until a block is complete, a duplex
+    // stream additionally buffers ahead of the output. Playback keeps the
+    // part of a block that did not fit into the last request.
+    if (stream_.mode != RtApi::OUTPUT) {
+        size_t frames = stream_.bufferSize;
+        if (mDuplexStream)
+            frames *= stream_.nBuffers * DUPLEX_INPUT_PERIODS;
+        mInputBlocks.resize(frames,
+                            stream_.nDeviceChannels[RtApi::INPUT]
+                                * RtApi::formatBytes(stream_.deviceFormat[RtApi::INPUT]));
+    }
+    if (stream_.mode != RtApi::INPUT)
+        mOutputCarry.resize(stream_.bufferSize,
+                            stream_.nDeviceChannels[RtApi::OUTPUT]
+                                * RtApi::formatBytes(stream_.deviceFormat[RtApi::OUTPUT]));
+}
+
+void RtApiPulseStream::finishStream()
+{
+    // Runs on the event thread, which can not wait for the server, so each
+    // step continues from the completion of the previous operation.
+    mFinishing = true;
+    mCallbackEnabled = false;
+    auto state = std::make_shared<FinishState>();
+    pa_operation *oper = nullptr;
+    if (stream_.mode == RtApi::INPUT) {
+        if (mFinishRequest == 1)
+            state->flushed = 1;
+        else
+            oper = mStream->requestFlush(&state->flushed);
+    } else if (mFinishRequest == 1) {
+        // The rest of the last block goes out before the drain.
+        writeOutputCarry(SIZE_MAX);
+        oper = mStream->requestDrain(&state->flushed);
+    } else {
+        oper = mStream->requestFlush(&state->flushed);
+    }
+    if (mDuplexStream) {
+        pa_operation *flushInput = mDuplexStream->requestFlush(nullptr);
+        if (flushInput)
+            pa_operation_unref(flushInput);
+    }
+    if (!oper) {
+        if (state->flushed == 100)
+            state->flushed = 0;
+        corkFinishedStream(std::move(state));
+        return;
+    }
+    mContextMainloop->getMainloop()->addTask(
+        std::make_shared<PaMainloopTask>(oper, std::move(state), [this](std::shared_ptr<OpaqueResultError> res) {
+            corkFinishedStream(std::move(res));
+        }));
+}
+
+void RtApiPulseStream::corkFinishedStream(std::shared_ptr<OpaqueResultError> res)
+{
+    auto state = std::static_pointer_cast<FinishState>(res);
+    auto complete = [this](const FinishState &state) {
+        bool success = state.flushed == 1 && state.corked[RtApi::OUTPUT] == 1
+                       && state.corked[RtApi::INPUT] == 1;
+        mFinishRequest = 0;
+        mFinishing = false;
+        stream_.state = RtApi::STREAM_STOPPED;
+        notifyStreamFinished(success ? RTAUDIO_NO_ERROR : RTAUDIO_SYSTEM_ERROR);
+    };
+    // The server answers in order, the record stream is acknowledged before
+    // the playback stream. Its task keeps the state alive until then.
+    state->corked[RtApi::INPUT] = 1;
+    if (mDuplexStream) {
+        pa_operation *corkInput = mDuplexStream->requestCork(true, &state->corked[RtApi::INPUT]);
+        if (corkInput)
+            mContextMainloop->getMainloop()->addTask(
+                std::make_shared<PaMainloopTask>(corkInput, state, [](std::shared_ptr<OpaqueResultError>) {}));
+    }
+    pa_operation *oper = mStream->requestCork(true, &state->corked[RtApi::OUTPUT]);
+    if (!oper) {
+        complete(*state);
+        return;
+    }
+    mContextMainloop->getMainloop()->addTask(
+        std::make_shared<PaMainloopTask>(oper, state, [complete](std::shared_ptr<OpaqueResultError> res) {
+            complete(*std::static_pointer_cast<FinishState>(res));
+        }));
+}
+
+void RtApiPulseStream::waitForFinish()
+{
+    if (mFinishing == false)
+        return;
+    auto context = mContextMainloop->getContext();
+    context->getMainloop()->runUntil([&]() { return mFinishing == false || context->hasError(); });
 }
 
 RtAudioErrorType RtApiPulseStream::stopStreamPriv()
 {
-    if (stream_.state != RtApi::STREAM_RUNNING) {
+    waitForFinish();
+    if (stream_.state != RtApi::STREAM_RUNNING && stream_.state != RtApi::STREAM_WARM) {
         return RTAUDIO_SYSTEM_ERROR;
     }
-    mThread.suspend();
-    if (mStream->pause() == false) {
+    mCallbackEnabled = false;
+    if (requestCorked() == false) {
         return RTAUDIO_SYSTEM_ERROR;
     }
     stream_.state = RtApi::STREAM_STOPPED;
     return RTAUDIO_NO_ERROR;
 }
 
-bool RtApiPulseStream::processOutput(size_t nsamples)
+bool RtApiPulseStream::processAudio(size_t nbytes)
 {
-    int pa_error = 0;
-    size_t bytes = 0;
-    void *pulse_out = stream_.doConvertBuffer[RtApi::OUTPUT]
-                          ? stream_.deviceBuffer.get()
-                          : stream_.userBuffer[RtApi::OUTPUT].get();
+    // Pulse asks for and delivers fragments of any size. The callback
+    // always gets whole blocks of bufferSize frames, the rest is carried
+    // over to the next request.
+    RtAudioStreamStatus status = mPendingStatus;
+    mPendingStatus = 0;
+    if (mFinishRequest != 0)
+        return true;
+    updateLatency(stream_.mode == RtApi::INPUT ? RtApi::INPUT : RtApi::OUTPUT, *mStream);
+    if (mCallbackEnabled == false)
+        return processSilence(nbytes);
 
-    if (stream_.doConvertBuffer[RtApi::OUTPUT]) {
-        RtApi::convertBuffer(stream_,
-                             stream_.deviceBuffer.get(),
-                             stream_.userBuffer[RtApi::OUTPUT].get(),
-                             stream_.convertInfo[RtApi::OUTPUT],
-                             nsamples,
-                             RtApi::OUTPUT);
-        bytes = stream_.nDeviceChannels[RtApi::OUTPUT] * nsamples
-                * RtApi::formatBytes(stream_.deviceFormat[RtApi::OUTPUT]);
-    } else
-        bytes = stream_.nUserChannels[RtApi::OUTPUT] * nsamples
-                * RtApi::formatBytes(stream_.userFormat);
+    if (stream_.mode == RtApi::INPUT)
+        return processInputFragments(status);
 
-    if (mStream->writeData(pulse_out, bytes) == false) {
-        stream_.errorState = true;
-        return false;
+    size_t frameBytes = stream_.nDeviceChannels[RtApi::OUTPUT]
+                        * RtApi::formatBytes(stream_.deviceFormat[RtApi::OUTPUT]);
+    size_t frames = nbytes / frameBytes;
+    frames -= writeOutputCarry(frames);
+    while (frames > 0 && mFinishRequest == 0) {
+        // Whole blocks are rendered into server memory when it is offered.
+        char *target = nullptr;
+        if (frames >= stream_.bufferSize)
+            target = static_cast<char *>(mStream->beginWrite(stream_.bufferSize * frameBytes));
+        const char *block = renderOutputBlock(target, status);
+        status = 0;
+        if (!block) {
+            if (target)
+                mStream->cancelWrite();
+            break;
+        }
+        size_t count = std::min<size_t>(frames, stream_.bufferSize);
+        if (mStream->writeData(block, count * frameBytes) == false) {
+            stream_.errorState = true;
+            return false;
+        }
+        if (count < stream_.bufferSize)
+            mOutputCarry.write(block + count * frameBytes, stream_.bufferSize - count);
+        frames -= count;
     }
     return true;
 }
 
-const void *RtApiPulseStream::processInput(size_t *nSamplesOut, size_t *nbytes)
+const char *RtApiPulseStream::renderOutputBlock(char *target, RtAudioStreamStatus status)
 {
-    const void *data = nullptr;
-    size_t readDataSize = mStream->peakData(&data);
-    if (readDataSize == 0) {
+    // target is server memory from beginWrite(). Without conversion the
+    // callback renders into it, otherwise the converter does.
+    RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
+    bool convert = stream_.doConvertBuffer[RtApi::OUTPUT];
+    const char *dataIn = mDuplexStream ? readInputBlock() : nullptr;
+    char *dataOut = target && convert == false ? target : stream_.userBuffer[RtApi::OUTPUT].get();
+    uint64_t callbackStart = mLatencyController ? XrunStatistics::monotonicNowNs() : 0;
+    mFinishRequest = callback(dataOut,
+                              dataIn,
+                              stream_.bufferSize,
+                              getStreamTime(),
+                              status,
+                              stream_.callbackInfo.userData);
+    if (mLatencyController) {
+        uint64_t callbackNs = XrunStatistics::monotonicNowNs() - callbackStart;
+        uint64_t periodNs = uint64_t(stream_.bufferSize) * 1000000000 / stream_.sampleRate;
+        if (mLatencyController->onPeriod(callbackNs, periodNs))
+            applyLatencyTarget();
+    }
+    if (mFinishRequest == 2)
         return nullptr;
+    tickStreamTime();
+    if (convert == false)
+        return dataOut;
+    char *converted = target ? target : stream_.deviceBuffer.get();
+    RtApi::convertBuffer(stream_,
+                         converted,
+                         stream_.userBuffer[RtApi::OUTPUT].get(),
+                         stream_.convertInfo[RtApi::OUTPUT],
+                         stream_.bufferSize,
+                         RtApi::OUTPUT);
+    return converted;
+}
+
+size_t RtApiPulseStream::writeOutputCarry(size_t frames)
+{
+    size_t frameBytes = mOutputCarry.channels();
+    AudioRingBuffer<char>::View carry = mOutputCarry.readView(frames);
+    for (const AudioRingBuffer<char>::Span &span : {carry.first, carry.second}) {
+        if (span.frames > 0 && mStream->writeData(span.data, span.frames * frameBytes) == false) {
+            stream_.errorState = true;
+            break;
+        }
     }
+    mOutputCarry.commitRead(carry.frames());
+    return carry.frames();
+}
 
-    size_t bufferSize = 0;
-    bufferSize = readDataSize / stream_.nDeviceChannels[RtApi::INPUT]
-                 / RtApi::formatBytes(stream_.deviceFormat[RtApi::INPUT]);
-
-    (*nSamplesOut) = bufferSize;
-    (*nbytes) = readDataSize;
-    if (stream_.doConvertBuffer[RtApi::INPUT]) {
-        RtApi::convertBuffer(stream_,
-                             stream_.userBuffer[RtApi::INPUT].get(),
-                             reinterpret_cast<const char *>(data),
-                             stream_.convertInfo[RtApi::INPUT],
-                             bufferSize,
-                             RtApi::INPUT);
-        return stream_.userBuffer[RtApi::INPUT].get();
-    } else {
-        return data;
+bool RtApiPulseStream::processInputFragments(RtAudioStreamStatus status)
+{
+    const void *data = nullptr;
+    size_t nbytes = 0;
+    size_t frameBytes = mInputBlocks.channels();
+    while (mFinishRequest == 0 && (nbytes = mStream->peakData(&data)) > 0) {
+        const char *fragment = static_cast<const char *>(data);
+        size_t frames = nbytes / frameBytes;
+        size_t done = 0;
+        while (done < frames && mFinishRequest == 0) {
+            if (fragment && mInputBlocks.readAvailable() == 0 && frames - done >= stream_.bufferSize) {
+                // Nothing carried over, whole blocks come straight from the server memory.
+                deliverInputBlock(convertInputBlock(fragment + done * frameBytes), status);
+                status = 0;
+                done += stream_.bufferSize;
+                continue;
+            }
+            // A null fragment is a hole in the record stream, the server
+            // lost captured data.
+            size_t count = std::min(frames - done, mInputBlocks.writeAvailable());
+            if (fragment) {
+                mInputBlocks.write(fragment + done * frameBytes, count);
+            } else {
+                mInputBlocks.writeSilence(count);
+                registerXrun(RTAUDIO_INPUT_OVERFLOW, XrunStatistics::monotonicNowNs(), count, 0);
+                status |= RTAUDIO_INPUT_OVERFLOW;
+            }
+            done += count;
+            while (mInputBlocks.readAvailable() >= stream_.bufferSize && mFinishRequest == 0) {
+                deliverInputBlock(readInputBlock(), status);
+                status = 0;
+            }
+        }
+        if (mStream->dropData() == false)
+            return false;
     }
+    return true;
 }
 
-bool RtApiPulseStream::processAudio(size_t nbytes)
+void RtApiPulseStream::deliverInputBlock(const char *block, RtAudioStreamStatus status)
 {
     RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
-    double streamTime = getStreamTime();
-    RtAudioStreamStatus status = 0;
+    mFinishRequest = callback(nullptr,
+                              block,
+                              stream_.bufferSize,
+                              getStreamTime(),
+                              status,
+                              stream_.callbackInfo.userData);
+    tickStreamTime();
+}
 
+bool RtApiPulseStream::processSilence(size_t nbytes)
+{
+    // Warm standby: keep the server fed and drop the captured data. Every
+    // fragment goes, so the first callbacks after the start get fresh input.
     if (stream_.mode == RtApi::INPUT) {
-        size_t bufferSize = 0;
-        size_t nbytesInput = 0;
-        const void *dataIn = processInput(&bufferSize, &nbytesInput);
-        assert(nbytesInput == nbytes);
-        if (nbytesInput != nbytes)
-            return false;
-
-        if (!dataIn || bufferSize == 0)
-            return false;
-        size_t samplesProcessed = 0;
-        while (samplesProcessed != bufferSize) {
-            size_t samplesToProcess = std::min(bufferSize - samplesProcessed,
-                                               (size_t) stream_.bufferSize);
-            callback(nullptr,
-                     reinterpret_cast<const char *>(dataIn) + samplesProcessed,
-                     samplesToProcess,
-                     streamTime,
-                     status,
-                     stream_.callbackInfo.userData);
-            tickStreamTime();
-            samplesProcessed += samplesToProcess;
-        }
-        mStream->dropData();
-    } else {
-        size_t bufferSize = 0;
-        bufferSize = nbytes / stream_.nDeviceChannels[RtApi::OUTPUT]
-                     / RtApi::formatBytes(stream_.deviceFormat[RtApi::OUTPUT]);
-
-        size_t samplesProcessed = 0;
-        while (samplesProcessed != bufferSize) {
-            size_t samplesToProcess = std::min(bufferSize - samplesProcessed,
-                                               (size_t) stream_.bufferSize);
-            callback(stream_.userBuffer[RtApi::OUTPUT].get(),
-                     nullptr,
-                     samplesToProcess,
-                     streamTime,
-                     status,
-                     stream_.callbackInfo.userData);
-            if (!processOutput(samplesToProcess))
+        const void *data = nullptr;
+        while (mStream->peakData(&data) > 0) {
+            if (mStream->dropData() == false)
                 return false;
-            tickStreamTime();
-            samplesProcessed += samplesToProcess;
         }
+        return true;
+    }
+    size_t frameBytes = stream_.nDeviceChannels[RtApi::OUTPUT]
+                        * RtApi::formatBytes(stream_.deviceFormat[RtApi::OUTPUT]);
+    size_t bufferBytes = stream_.bufferSize * frameBytes;
+    char *silence = stream_.doConvertBuffer[RtApi::OUTPUT] ? stream_.deviceBuffer.get()
+                                                           : stream_.userBuffer[RtApi::OUTPUT].get();
+    bool silenceCleared = false;
+    while (nbytes > 0) {
+        size_t bytes = std::min(nbytes, bufferBytes);
+        char *data = static_cast<char *>(mStream->beginWrite(bytes));
+        if (data) {
+            memset(data, 0, bytes);
+        } else if (silenceCleared == false) {
+            memset(silence, 0, bufferBytes);
+            silenceCleared = true;
+        }
+        if (mStream->writeData(data ? data : silence, bytes) == false) {
+            stream_.errorState = true;
+            return false;
+        }
+        nbytes -= bytes;
     }
     return true;
 }
+
+void RtApiPulseStream::processXrun(RtAudioStreamStatus type, unsigned long framesLost)
+{
+    // Pulse recovers by itself, only holes in record streams tell how much was lost.
+    mPendingStatus |= type;
+    registerXrun(type, XrunStatistics::monotonicNowNs(), framesLost, 0);
+    if (type == RTAUDIO_OUTPUT_UNDERFLOW && mLatencyController && mLatencyController->onXrun())
+        applyLatencyTarget();
+}
+
+void RtApiPulseStream::captureDuplexInput()
+{
+    // Runs on the same mainloop as the playback requests, the captured
+    // fragments wait in the ring for the next output block.
+    updateLatency(RtApi::INPUT, *mDuplexStream);
+    const void *data = nullptr;
+    size_t nbytes = 0;
+    while ((nbytes = mDuplexStream->peakData(&data)) > 0) {
+        size_t frames = nbytes / mInputBlocks.channels();
+        // A hole in the record stream means the server lost captured data,
+        // a full ring means it is dropped here. Either way the
+        // fragment counts once. Warm standby drops the input.
+        bool lost = false;
+        if (mCallbackEnabled && data) {
+            lost = mInputBlocks.write(static_cast<const char *>(data), frames) == false;
+        } else if (mCallbackEnabled) {
+            mInputBlocks.writeSilence(frames);
+            lost = true;
+        }
+        mDuplexStream->dropData();
+        if (lost)
+            processXrun(RTAUDIO_INPUT_OVERFLOW, frames);
+    }
+}
+
+const char *RtApiPulseStream::readInputBlock()
+{
+    // Input not captured yet, right after the start or on a late record
+    // stream, is replaced by silence.
+    char *buffer = stream_.doConvertBuffer[RtApi::INPUT] ? stream_.deviceBuffer.get()
+                                                         : stream_.userBuffer[RtApi::INPUT].get();
+    size_t frameBytes = mInputBlocks.channels();
+    size_t available = std::min<size_t>(mInputBlocks.readAvailable(), stream_.bufferSize);
+    mInputBlocks.read(buffer, available);
+    memset(buffer + available * frameBytes, 0, (stream_.bufferSize - available) * frameBytes);
+    return convertInputBlock(buffer);
+}
+
+const char *RtApiPulseStream::convertInputBlock(const char *block)
+{
+    if (stream_.doConvertBuffer[RtApi::INPUT] == false)
+        return block;
+    RtApi::convertBuffer(stream_,
+                         stream_.userBuffer[RtApi::INPUT].get(),
+                         block,
+                         stream_.convertInfo[RtApi::INPUT],
+                         stream_.bufferSize,
+                         RtApi::INPUT);
+    return stream_.userBuffer[RtApi::INPUT].get();
+}
+
+bool RtApiPulseStream::requestCorked()
+{
+    // Stopping does not wait for the server. The callback is off already,
+    // requests arriving meanwhile only get silence, and the server handles
+    // a later uncork after this cork.
+    for (PaStream *stream : {mStream.get(), mDuplexStream.get()}) {
+        pa_operation *oper = stream ? stream->requestCork(true, nullptr) : nullptr;
+        if (oper)
+            pa_operation_unref(oper);
+    }
+    return mContextMainloop->getContext()->hasError() == false;
+}
+
+bool RtApiPulseStream::setCorked(bool cork)
+{
+    if (!mDuplexStream)
+        return cork ? mStream->pause() : mStream->play();
+    PaMainloop::Lock lock(*mContextMainloop->getMainloop());
+    // Both requests go out before waiting, so the server starts and
+    // stops record and playback in the same mainloop iteration.
+    int successOutput = 0;
+    int successInput = 0;
+    pa_operation *operOutput = mStream->requestCork(cork, &successOutput);
+    pa_operation *operInput = mDuplexStream->requestCork(cork, &successInput);
+    auto context = mContextMainloop->getContext();
+    context->getMainloop()->runUntil(
+        [&]() { return (successOutput != 100 && successInput != 100) || context->hasError(); });
+    PaMainloop::releaseOperation(operOutput);
+    PaMainloop::releaseOperation(operInput);
+    return successOutput == 1 && successInput == 1;
+}
+
+void RtApiPulseStream::updateLatency(int mode, const PaStream &stream)
+{
+    // Without a timing update yet the configured latency stays in place.
+    pa_usec_t usec = 0;
+    if (stream.getLatency(&usec))
+        stream_.latency[mode] = usec * stream_.sampleRate / 1000000;
+}
+
+void RtApiPulseStream::setupLatencyController()
+{
+    mLatencyController.reset();
+    if (!stream_.adaptiveLatency || stream_.mode != RtApi::OUTPUT || stream_.bufferSize == 0)
+        return;
+    mLatencyController = std::make_unique<LatencyController>(2,
+                                                             stream_.nBuffers,
+                                                             stream_.sampleRate / stream_.bufferSize);
+    applyLatencyTarget();
+}
+
+void RtApiPulseStream::applyLatencyTarget()
+{
+    // With PA_STREAM_ADJUST_LATENCY tlength is the overall output latency.
+    unsigned int bufferBytes = stream_.nDeviceChannels[RtApi::OUTPUT] * stream_.bufferSize
+                               * RtApi::formatBytes(stream_.deviceFormat[RtApi::OUTPUT]);
+    pa_buffer_attr attr = mStream->getBufferAttr();
+    attr.tlength = bufferBytes * mLatencyController->periods();
+    attr.minreq = bufferBytes;
+    attr.prebuf = attr.tlength;
+    if (mStream->requestBufferAttr(attr) == false)
+        return;
+    notifyLatencyChanged(mLatencyController->periods() * stream_.bufferSize);
+}
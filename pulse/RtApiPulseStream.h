@@ -1,30 +1,69 @@
 #pragma once
+#include "AudioRingBuffer.h"
 #include "RtAudio.h"
-#include "ThreadSuspendable.h"
+#include <atomic>
 #include <pulse/simple.h>
 
+class LatencyController;
 class PaContextWithMainloop;
 class PaStream;
+struct OpaqueResultError;
 
 class RtApiPulseStream : public RtApiStreamClass
 {
 public:
+    // Duplex streams pass the playback stream as stream and the record
+    // stream as duplexInput, both connected through contextMainloop.
     RtApiPulseStream(RtApi::RtApiStream apiStream,
                      std::shared_ptr<PaContextWithMainloop> contextMainloop,
-                     std::shared_ptr<PaStream> stream);
+                     std::shared_ptr<PaStream> stream,
+                     std::shared_ptr<PaStream> duplexInput = {});
     ~RtApiPulseStream();
     RtAudio::Api getCurrentApi(void) override { return RtAudio::LINUX_PULSE; }
     RtAudioErrorType startStream(void) override;
     RtAudioErrorType stopStream(void) override;
+    RtAudioErrorType warmStream(void) override;
+    RtAudioErrorType pauseStream(void) override;
+    RtAudioErrorType resumeStream(void) override;
+    RtAudioErrorType reconfigure(unsigned int bufferSize, unsigned int sampleRate) override;
 
 private:
-    bool threadMethod();
-
     RtAudioErrorType stopStreamPriv(void);
-    bool processOutput(size_t nbytes);
-    const void *processInput(size_t *nSamplesOut, size_t *nbytes);
     bool processAudio(size_t nbytes);
+    const char *renderOutputBlock(char *target, RtAudioStreamStatus status);
+    size_t writeOutputCarry(size_t frames);
+    bool processInputFragments(RtAudioStreamStatus status);
+    void deliverInputBlock(const char *block, RtAudioStreamStatus status);
+    bool processSilence(size_t nbytes);
+    void processXrun(RtAudioStreamStatus type, unsigned long framesLost = 0);
+    void captureDuplexInput();
+    const char *readInputBlock();
+    const char *convertInputBlock(const char *block);
+    void resizeBlockBuffers();
+    bool setCorked(bool cork);
+    bool requestCorked();
+    void finishStream();
+    void corkFinishedStream(std::shared_ptr<OpaqueResultError> state);
+    void waitForFinish();
+    // Stores the server side latency of one direction in stream_.latency.
+    void updateLatency(int mode, const PaStream &stream);
+    void setupLatencyController();
+    void applyLatencyTarget();
     std::shared_ptr<PaContextWithMainloop> mContextMainloop;
+    int mRealtimeRequest = 0;
     std::shared_ptr<PaStream> mStream;
-    ThreadSuspendable mThread;
+    // Record side of duplex streams. Its fragments are collected in
+    // mInputBlocks and handed to the callback with each output block.
+    std::shared_ptr<PaStream> mDuplexStream;
+    // The callback always sees bufferSize frames. Captured frames wait here
+    // for a complete block, rendered frames beyond a request in mOutputCarry.
+    AudioRingBuffer<char> mInputBlocks;
+    AudioRingBuffer<char> mOutputCarry;
+
+    RtAudioStreamStatus mPendingStatus = 0;
+    std::unique_ptr<LatencyController> mLatencyController;
+    std::atomic_bool mCallbackEnabled = false;
+    RtApi::StreamState mStateBeforePause = RtApi::STREAM_STOPPED;
+    int mFinishRequest = 0; // Nonzero callback return value, kept until the stream is corked.
+    bool mFinishing = false;
 };
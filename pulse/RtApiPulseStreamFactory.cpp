@@ -3,6 +3,7 @@
 #include "PaMainloop.h"
 #include "PaStream.h"
 #include "PulseCommon.h"
+#include "PulseDeviceRegistry.h"
 #include "RtApiPulseStream.h"
 #include <memory>
 #include <pulse/pulseaudio.h>
@@ -56,22 +57,15 @@ void rt_pa_context_state_cb(pa_context *context, void *userdata)
 } // namespace
 std::shared_ptr<RtApiStreamClass> RtApiPulseStreamFactory::createStream(CreateStreamParams params)
 {
-    if (params.mode == RtApi::DUPLEX) {
-        /* Note: We could add DUPLEX by synchronizing multiple streams,
-       but it would mean moving from Simple API to Asynchronous API:
-       https://freedesktop.org/software/pulseaudio/doxygen/streams.html#sync_streams */
-        error(RTAUDIO_SYSTEM_ERROR,
-              "RtApiPulseStreamFactory::createStream: DUPLEX mode not supported by Pulse.");
+    // Duplex streams are a record and a playback stream on the shared
+    // context, both driven by its event thread, see RtApiPulseStream.
+    bool output = params.mode == RtApi::OUTPUT || params.mode == RtApi::DUPLEX;
+    bool input = params.mode == RtApi::INPUT || params.mode == RtApi::DUPLEX;
+    if (!output && !input) {
+        error(RTAUDIO_SYSTEM_ERROR, "RtApiPulseStreamFactory::createStream: invalid stream mode.");
         return {};
     }
-
-    pa_sample_spec ss{};
-    if (params.mode == RtApi::OUTPUT) {
-        ss.channels = params.channelsOutput;
-    } else {
-        ss.channels = params.channelsInput;
-    }
-    if (ss.channels == 0) {
+    if ((output && params.channelsOutput == 0) || (input && params.channelsInput == 0)) {
         error(RTAUDIO_SYSTEM_ERROR, "RtApiPulseStreamFactory::createStream: no channels.");
         return {};
     }
@@ -80,51 +74,105 @@ std::shared_ptr<RtApiStreamClass> RtApiPulseStreamFactory::createStream(CreateSt
               "RtApiPulseStreamFactory::createStream: samplerate not supported.");
         return {};
     }
-    ss.rate = params.sampleRate;
-    ss.format = getPulseFormatByRt(params.format);
-    if (ss.format == PA_SAMPLE_INVALID) {
+    if (RtApi::formatBytes(params.format) == 0) {
         error(RTAUDIO_SYSTEM_ERROR,
               "RtApiPulseStreamFactory::createStream: sample format not supported.");
         return {};
     }
 
-    int error_code = 0;
-    pa_channel_map mapping{};
-    if (pa_channel_map_init_extend(&mapping, ss.channels, PA_CHANNEL_MAP_WAVEEX) == NULL) {
-        error(RTAUDIO_SYSTEM_ERROR,
-              "RtApiPulseStreamFactory::createStream: channels map not initialized.");
+    auto contextWithLoop = PaContextWithMainloop::GetShared();
+    if (!contextWithLoop) {
+        errorStream_ << "RtApiPulseStreamFactory::createStream: failed to connect to the server.";
+        error(RTAUDIO_SYSTEM_ERROR, errorStream_.str());
         return {};
     }
 
+    // A duplex stream opens the sink and the source of one card.
+    auto registry = PulseDeviceRegistry::GetShared();
+    std::string devices[2];
+    if (params.mode == RtApi::DUPLEX) {
+        std::optional<std::pair<std::string, std::string>> duplexDevices;
+        if (registry)
+            duplexDevices = registry->findDuplexDevices(params.busId);
+        if (!duplexDevices) {
+            errorStream_ << "RtApiPulseStreamFactory::createStream: no sink and source pair for device ("
+                         << params.busId << ").";
+            error(RTAUDIO_INVALID_DEVICE, errorStream_.str());
+            return {};
+        }
+        devices[RtApi::OUTPUT] = duplexDevices->first;
+        devices[RtApi::INPUT] = duplexDevices->second;
+    } else {
+        devices[params.mode] = params.busId;
+    }
+
+    // Streams run at the format of the sink or source and RtAudio converts
+    // the user format, the shared server would otherwise do it for us.
+    RtAudioFormat deviceFormat[2]{};
+    pa_sample_spec ss[2]{};
+    pa_channel_map mapping[2]{};
+    for (int mode : {RtApi::OUTPUT, RtApi::INPUT}) {
+        if ((mode == RtApi::OUTPUT && !output) || (mode == RtApi::INPUT && !input))
+            continue;
+        // An empty name opens the server default.
+        std::optional<PulseSinkSourceInfo> device;
+        if (registry) {
+            std::string name = devices[mode];
+            if (name.empty()) {
+                ServerInfoStruct serverInfo = registry->getServerInfo();
+                name = mode == RtApi::OUTPUT ? serverInfo.defaultSinkName : serverInfo.defaultSourceName;
+            }
+            device = registry->findByName(name);
+        }
+        deviceFormat[mode] = device ? getRtFormatByPulse(device->format) : 0;
+        if (deviceFormat[mode] == 0)
+            deviceFormat[mode] = getPulseFormatByRt(params.format) != PA_SAMPLE_INVALID ? params.format
+                                                                                        : RTAUDIO_FLOAT32;
+        ss[mode].channels = mode == RtApi::OUTPUT ? params.channelsOutput : params.channelsInput;
+        ss[mode].rate = params.sampleRate;
+        ss[mode].format = getPulseFormatByRt(deviceFormat[mode]);
+        if (pa_channel_map_init_extend(&mapping[mode], ss[mode].channels, PA_CHANNEL_MAP_WAVEEX) == NULL) {
+            error(RTAUDIO_SYSTEM_ERROR,
+                  "RtApiPulseStreamFactory::createStream: channels map not initialized.");
+            return {};
+        }
+    }
+
     std::string streamName = "RtAudio";
     if (params.options && !params.options->streamName.empty())
         streamName = params.options->streamName;
 
-    unsigned int bufferBytes = ss.channels * params.bufferSize * RtApi::formatBytes(params.format);
     unsigned int buffersCount = 4;
 
     if (params.options && params.options->numberOfBuffers > 0) {
         buffersCount = params.options->numberOfBuffers;
     }
-
-    pa_buffer_attr buffer_attr{};
-    buffer_attr.minreq = -1;
-    buffer_attr.prebuf = -1;
-    buffer_attr.tlength = -1;
-
-    if (params.mode == RtApi::INPUT) {
-        buffer_attr.fragsize = bufferBytes;
-        buffer_attr.maxlength = bufferBytes * buffersCount;
-    } else if (params.mode == RtApi::OUTPUT) {
-        buffer_attr.maxlength = bufferBytes * buffersCount;
+    if (params.options && params.options->flags & RTAUDIO_MINIMIZE_LATENCY)
+        buffersCount = 2;
+    bool adaptiveLatency = params.options && params.options->flags & RTAUDIO_ADAPTIVE_LATENCY;
+    if (adaptiveLatency) {
+        // Room for the adaptive target to grow, see RtApiPulseStream.
+        buffersCount = std::max(buffersCount, 8u);
     }
 
+    pa_buffer_attr buffer_attr[2]{};
     RtApi::RtApiStream stream_{};
-    stream_.nDeviceChannels[params.mode] = ss.channels;
-    stream_.deviceFormat[params.mode] = params.format;
-    stream_.doByteSwap[params.mode] = false;
-    stream_.deviceInterleaved[params.mode] = true;
-    stream_.latency[params.mode] = 0;
+    for (int mode : {RtApi::OUTPUT, RtApi::INPUT}) {
+        if (ss[mode].channels == 0)
+            continue;
+        unsigned int bufferBytes = ss[mode].channels * params.bufferSize * RtApi::formatBytes(deviceFormat[mode]);
+        buffer_attr[mode] = PulseCommon::makeBufferAttr(RtApi::StreamMode(mode), bufferBytes, buffersCount);
+        if (adaptiveLatency && mode == RtApi::OUTPUT) {
+            buffer_attr[mode].tlength = bufferBytes * 2;
+            buffer_attr[mode].minreq = bufferBytes;
+            buffer_attr[mode].prebuf = buffer_attr[mode].tlength;
+        }
+        stream_.nDeviceChannels[mode] = ss[mode].channels;
+        stream_.deviceFormat[mode] = deviceFormat[mode];
+        stream_.doByteSwap[mode] = false;
+        stream_.deviceInterleaved[mode] = true;
+        stream_.latency[mode] = 0;
+    }
     stream_.nBuffers = buffersCount;
 
     if (params.options && params.options->flags & RTAUDIO_SCHEDULE_REALTIME) {
@@ -143,29 +191,41 @@ std::shared_ptr<RtApiStreamClass> RtApiPulseStreamFactory::createStream(CreateSt
         return {};
     }
 
-    auto contextWithLoop = PaContextWithMainloop::Create(nullptr);
-    if (!contextWithLoop) {
-        errorStream_ << "RtApiPulse::probeDevices: failed to create context with mainloop.";
-        error(RTAUDIO_SYSTEM_ERROR, errorStream_.str());
-        return {};
-    }
-
-    const char *dev_name = params.busId.c_str();
-    std::shared_ptr<PaStream> stream = std::make_shared<PaStream>(contextWithLoop->getContext(),
-                                                                  "RtAudio",
-                                                                  ss,
-                                                                  mapping);
-    if (stream->isValid() == false) {
-        error(RTAUDIO_SYSTEM_ERROR,
-              "RtApiPulse::probeDeviceOpen: error connecting output to PulseAudio server.");
-        return {};
+    bool variableRate = params.options && params.options->flags & RTAUDIO_VARIABLE_RATE;
+    std::shared_ptr<PaStream> streams[2];
+    for (int mode : {RtApi::OUTPUT, RtApi::INPUT}) {
+        if (ss[mode].channels == 0)
+            continue;
+        streams[mode] = std::make_shared<PaStream>(contextWithLoop->getContext(),
+                                                   streamName.c_str(),
+                                                   ss[mode],
+                                                   mapping[mode]);
+        const char *direction = mode == RtApi::INPUT ? "input" : "output";
+        if (streams[mode]->isValid() == false) {
+            errorStream_ << "RtApiPulseStreamFactory::createStream: error creating the " << direction
+                         << " stream.";
+            error(RTAUDIO_SYSTEM_ERROR, errorStream_.str());
+            return {};
+        }
+        if (streams[mode]->connect(devices[mode].c_str(), buffer_attr[mode], mode == RtApi::INPUT, variableRate)
+            == false) {
+            errorStream_ << "RtApiPulseStreamFactory::createStream: error connecting " << direction
+                         << " to PulseAudio server.";
+            error(RTAUDIO_SYSTEM_ERROR, errorStream_.str());
+            return {};
+        }
+        stream_.latency[mode] = PulseCommon::configuredLatencyFrames(RtApi::StreamMode(mode),
+                                                                     streams[mode]->getBufferAttr(),
+                                                                     pa_frame_size(&ss[mode]));
     }
-    if (stream->connect(dev_name, buffer_attr, params.mode == RtApi::INPUT) == false) {
-        error(RTAUDIO_SYSTEM_ERROR,
-              "RtApiPulse::probeDeviceOpen: error connecting output to PulseAudio server.");
-        return {};
+    if (params.mode == RtApi::DUPLEX) {
+        // The playback stream drives the callback, the record stream feeds its input.
+        return std::make_shared<RtApiPulseStream>(stream_,
+                                                  std::move(contextWithLoop),
+                                                  std::move(streams[RtApi::OUTPUT]),
+                                                  std::move(streams[RtApi::INPUT]));
     }
     return std::make_shared<RtApiPulseStream>(stream_,
                                               std::move(contextWithLoop),
-                                              std::move(stream));
+                                              std::move(streams[params.mode]));
 }
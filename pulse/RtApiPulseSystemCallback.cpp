@@ -1,151 +1,99 @@
 #include "RtApiPulseSystemCallback.h"
-#include "PaContextWithMainloop.h"
-#include "PaMainloop.h"
-#include "PulseCommon.h"
-#include "pulse/PaContext.h"
-#include <pulse/context.h>
-#include <pulse/def.h>
-#include <pulse/mainloop.h>
-#include <pulse/pulseaudio.h>
+#include "PulseDeviceRegistry.h"
+#include <algorithm>
 
 namespace {
-
-void rt_pa_context_success_cb(pa_context *c, int success, void *userdata)
-{
-    assert(userdata);
-    int *res = reinterpret_cast<int *>(userdata);
-    (*res) = success;
-}
-
-void pa_context_subscribe_cb(pa_context *c,
-                             pa_subscription_event_type_t t,
-                             uint32_t idx,
-                             void *userdata)
-{
-    assert(userdata);
-    RtApiPulseSystemCallback *stream = reinterpret_cast<RtApiPulseSystemCallback *>(userdata);
-    stream->handleEvent(c, t, idx);
-}
-
-enum PulseSinkSourceType getPulseSinkSourceTypeByFacility(unsigned facility)
-{
-    switch (facility) {
-    case PA_SUBSCRIPTION_EVENT_SINK:
-        return PulseSinkSourceType::SINK;
-    case PA_SUBSCRIPTION_EVENT_SOURCE: {
-        return PulseSinkSourceType::SOURCE;
-    } break;
-    }
-    assert(false);
-    return PulseSinkSourceType::SOURCE;
-}
-
-RtAudioDeviceParam getRtAudioDeviceParamByPulseEvent(unsigned evt)
-{
-    switch (evt) {
-    case PA_SUBSCRIPTION_EVENT_CHANGE:
-        return RtAudioDeviceParam::DEVICE_STATE_CHANGED;
-    case PA_SUBSCRIPTION_EVENT_NEW:
-        return RtAudioDeviceParam::DEVICE_ADDED;
-    case PA_SUBSCRIPTION_EVENT_REMOVE:
-        return RtAudioDeviceParam::DEVICE_REMOVED;
-    }
-    assert(false);
-    return RtAudioDeviceParam::DEVICE_STATE_CHANGED;
-};
+// A burst ends once the server was quiet for a moment, but notifications
+// are never held back for long.
+constexpr std::chrono::milliseconds COALESCE_QUIET_TIME{50};
+constexpr std::chrono::milliseconds COALESCE_MAX_DELAY{250};
 } // namespace
 
 RtApiPulseSystemCallback::RtApiPulseSystemCallback(RtAudioDeviceCallbackLambda callback)
     : mCallback(callback)
 {
-    mContextWithLoop = PaContextWithMainloop::Create(nullptr);
-    if (!mContextWithLoop) {
-        errorStream_ << "RtApiPulse::probeDevices: failed to create context with mainloop.";
+    mRegistry = PulseDeviceRegistry::GetShared();
+    if (!mRegistry) {
+        errorStream_ << "RtApiPulseSystemCallback: failed to connect to the server.";
         error(RTAUDIO_SYSTEM_ERROR, errorStream_.str());
         return;
     }
-    pa_context_set_subscribe_callback(mContextWithLoop->getContext()->handle(),
-                                      pa_context_subscribe_cb,
-                                      this);
-
-    int success = 100;
-    pa_operation *operation = pa_context_subscribe(mContextWithLoop->getContext()->handle(),
-                                                   static_cast<pa_subscription_mask_t>(
-                                                       PA_SUBSCRIPTION_MASK_ALL),
-                                                   &rt_pa_context_success_cb,
-                                                   &success);
-    if (!operation)
-        return;
-    mContextWithLoop->getContext()->getMainloop()->runUntil(
-        [&]() { return mContextWithLoop->getContext()->hasError() || success != 100; });
-    pa_operation_unref(operation);
-    if (success != 1) {
-        return;
-    }
-    mHasError = false;
     mNotificationThread = std::thread(&RtApiPulseSystemCallback::notificationThread, this);
+    mListenerId = mRegistry->addListener(
+        [this](const std::string &name, RtAudioDeviceParam param) { postNotification(name, param); });
 }
 
 RtApiPulseSystemCallback::~RtApiPulseSystemCallback()
 {
-    if (!mContextWithLoop) {
-        return;
-    }
-    mContextWithLoop->getContext()->getMainloop()->stop();
-    mNotificationThread.join();
-    pa_context_set_subscribe_callback(mContextWithLoop->getContext()->handle(), nullptr, this);
-}
-
-void RtApiPulseSystemCallback::handleEvent(pa_context *c,
-                                           pa_subscription_event_type_t t,
-                                           uint32_t idx)
-{
-    unsigned facility = t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
-    switch (facility) {
-    case PA_SUBSCRIPTION_EVENT_SINK:
-    case PA_SUBSCRIPTION_EVENT_SOURCE: {
-        checkDefaultChanged(c, idx, t);
-    } break;
-    default:
-        break;
+    if (mRegistry && mListenerId)
+        mRegistry->removeListener(mListenerId);
+    if (mNotificationThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> g(mQueueMutex);
+            mQuit = true;
+        }
+        mQueueChanged.notify_all();
+        mNotificationThread.join();
     }
 }
 
 bool RtApiPulseSystemCallback::hasError() const
 {
-    return mHasError;
+    if (!mRegistry || mListenerId == 0)
+        return true;
+    return mRegistry->hasError();
 }
 
 void RtApiPulseSystemCallback::notificationThread()
 {
-    mContextWithLoop->getContext()->getMainloop()->runUntil(
-        [this]() { return mContextWithLoop->getContext()->hasError(); });
-    mHasError = true;
+    std::unique_lock<std::mutex> g(mQueueMutex);
+    while (true) {
+        mQueueChanged.wait(g, [this]() { return mQuit || !mQueue.empty(); });
+        auto burstEnd = std::chrono::steady_clock::now() + COALESCE_MAX_DELAY;
+        while (mQuit == false) {
+            auto deadline = std::min(mLastPost + COALESCE_QUIET_TIME, burstEnd);
+            if (std::chrono::steady_clock::now() >= deadline)
+                break;
+            mQueueChanged.wait_until(g, deadline);
+        }
+        if (mQuit)
+            return;
+        auto notifications = std::move(mQueue);
+        mQueue.clear();
+        g.unlock();
+        for (const auto &notification : notifications)
+            mCallback(notification.first, notification.second);
+        g.lock();
+    }
 }
 
-void RtApiPulseSystemCallback::checkDefaultChanged(pa_context *c, uint32_t idx, unsigned int t)
+void RtApiPulseSystemCallback::postNotification(std::string name, RtAudioDeviceParam param)
 {
-    unsigned facility = t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
-    unsigned int evt = t & PA_SUBSCRIPTION_EVENT_TYPE_MASK;
-
-    switch (evt) {
-    case PA_SUBSCRIPTION_EVENT_CHANGE:
-    case PA_SUBSCRIPTION_EVENT_NEW: {
-        PulseCommon::getSinkSourceInfoAsync(mContextWithLoop->getContext(),
-                                            idx,
-                                            getPulseSinkSourceTypeByFacility(facility),
-                                            [evt, this](std::optional<PulseSinkSourceInfo> info) {
-                                                if (!info) {
-                                                    return;
-                                                }
-                                                mCallback(info->name,
-                                                          getRtAudioDeviceParamByPulseEvent(evt));
-                                            });
-    } break;
-    case PA_SUBSCRIPTION_EVENT_REMOVE: {
-        mCallback("", RtAudioDeviceParam::DEVICE_REMOVED);
-    } break;
-    default:
-        break;
+    {
+        std::lock_guard<std::mutex> g(mQueueMutex);
+        mLastPost = std::chrono::steady_clock::now();
+        auto isPending = [&](RtAudioDeviceParam pendingParam) {
+            return std::find(mQueue.begin(), mQueue.end(), std::make_pair(name, pendingParam)) != mQueue.end();
+        };
+        auto dropPending = [&](RtAudioDeviceParam pendingParam) {
+            mQueue.erase(std::remove(mQueue.begin(), mQueue.end(), std::make_pair(name, pendingParam)),
+                         mQueue.end());
+        };
+        // Within one burst a device is reported once. Changes of a device
+        // that is announced anyway are dropped, as is a device that came
+        // and went again.
+        if (param == RtAudioDeviceParam::DEVICE_REMOVED) {
+            dropPending(RtAudioDeviceParam::DEVICE_STATE_CHANGED);
+            if (isPending(RtAudioDeviceParam::DEVICE_ADDED)) {
+                dropPending(RtAudioDeviceParam::DEVICE_ADDED);
+                return;
+            }
+        }
+        if (isPending(param))
+            return;
+        if (param == RtAudioDeviceParam::DEVICE_STATE_CHANGED && isPending(RtAudioDeviceParam::DEVICE_ADDED))
+            return;
+        mQueue.emplace_back(std::move(name), param);
     }
+    mQueueChanged.notify_one();
 }
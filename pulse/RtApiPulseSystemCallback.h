@@ -1,12 +1,15 @@
 #pragma once
 
 #include "RtAudio.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <optional>
 #include <pulse/def.h>
 #include <thread>
 
-struct pa_context;
-class PaContextWithMainloop;
+class PulseDeviceRegistry;
 
 class RTAUDIO_DLL_PUBLIC RtApiPulseSystemCallback : public RtApiSystemCallback
 {
@@ -15,16 +18,24 @@ public:
     ~RtApiPulseSystemCallback();
 
     virtual RtAudio::Api getCurrentApi(void) override { return RtAudio::LINUX_PULSE; }
-    void handleEvent(pa_context *c, pa_subscription_event_type_t t, uint32_t idx);
 
     virtual bool hasError() const override;
 
 private:
     void notificationThread();
-    void checkDefaultChanged(pa_context *c, uint32_t idx, unsigned int t);
+    void postNotification(std::string name, RtAudioDeviceParam param);
 
-    std::thread mNotificationThread;
     RtAudioDeviceCallbackLambda mCallback;
-    std::shared_ptr<PaContextWithMainloop> mContextWithLoop;
-    std::atomic_bool mHasError = true;
+    std::shared_ptr<PulseDeviceRegistry> mRegistry;
+    int mListenerId = 0;
+
+    // Changes arrive on the shared event thread, the user callback runs on
+    // the notification thread so it may use the api again. Bursts, like a
+    // dock bringing several devices, are collected and delivered at once.
+    std::mutex mQueueMutex;
+    std::condition_variable mQueueChanged;
+    std::deque<std::pair<std::string, RtAudioDeviceParam>> mQueue;
+    std::chrono::steady_clock::time_point mLastPost;
+    bool mQuit = false;
+    std::thread mNotificationThread;
 };
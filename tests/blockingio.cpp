@@ -0,0 +1,135 @@
+/******************************************/
+/*
+  blockingio.cpp
+
+  Passes the input of a device through to its
+  output with blocking read() and write() calls
+  from the main thread, or plays sawtooth waves
+  if the device has no input.
+*/
+/******************************************/
+
+#include "BlockingStream.h"
+#include "RtAudio.h"
+#include "cliutils.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+typedef float MY_TYPE;
+#define FORMAT RTAUDIO_FLOAT32
+
+void usage(const CLIParams& params) {
+    std::cout << "\nuseage: blockingio " << params.getShortString() << "\n";
+    std::cout << params.getFullString();
+}
+
+void errorCallback(RtAudioErrorType /*type*/, const std::string& errorText)
+{
+    std::cerr << "\nerrorCallback: " << errorText << "\n\n";
+}
+
+int main(int argc, char* argv[])
+{
+    CLIParams params({
+        {"api", "name of audio API", false},
+        {"device", "device name to use", false},
+        {"channels", "number of channels", true, "2"},
+        {"samplerate", "the sample rate", true, "0"},
+        {"buffer", "buffer frames", true, "256"},
+        {"time", "time duration in milliseconds", true, "2000"},
+        {"ring", "ring depth in frames, 0 for four buffers", true, "0"},
+        });
+
+    if (params.checkCountArgc(argc) == false) {
+        usage(params);
+        return 1;
+    }
+    auto api = RtAudio::getCompiledApiByName(params.getParamValue("api", argv, argc));
+    if (api == RtAudio::UNSPECIFIED) {
+        std::cout << "\nNo api found!\n";
+        return 1;
+    }
+    auto enumerator = RtAudio::GetRtAudioEnumerator(api);
+    auto prober = RtAudio::GetRtAudioProber(api);
+    auto factory = RtAudio::GetRtAudioStreamFactory(api);
+    if (!enumerator || !prober || !factory) {
+        std::cout << "\nApi not supported!\n";
+        return 1;
+    }
+    factory->setErrorCallback(errorCallback);
+
+    std::optional<RtAudio::DeviceInfo> device;
+    for (auto& d : enumerator->listDevices()) {
+        if (d.name == params.getParamValue("device", argv, argc) && d.supportsOutput) {
+            device = prober->probeDevice(d.busID);
+            break;
+        }
+    }
+    if (!device) {
+        std::cout << "No device found" << std::endl;
+        return 1;
+    }
+
+    unsigned int channels = atoi(params.getParamValue("channels", argv, argc));
+    unsigned int fs = atoi(params.getParamValue("samplerate", argv, argc));
+    unsigned int durationMs = atoi(params.getParamValue("time", argv, argc));
+    unsigned long ringFrames = atol(params.getParamValue("ring", argv, argc));
+    if (fs == 0)
+        fs = device->preferredSampleRate;
+    bool duplex = device->inputChannels >= channels;
+
+    CreateStreamParams streamParams{};
+    streamParams.busId = device->partial.busID;
+    streamParams.mode = duplex ? RtApi::DUPLEX : RtApi::OUTPUT;
+    streamParams.channelsOutput = channels;
+    streamParams.channelsInput = duplex ? channels : 0;
+    streamParams.sampleRate = fs;
+    streamParams.format = FORMAT;
+    streamParams.bufferSize = atoi(params.getParamValue("buffer", argv, argc));
+
+    auto stream = BlockingStream::open(*factory, streamParams, ringFrames);
+    if (!stream) {
+        std::cout << "\nFailed to create stream!\n";
+        return 1;
+    }
+    stream->getStream().setErrorCallback(errorCallback);
+    unsigned int bufferFrames = stream->getStream().getBufferSize();
+    std::cout << (duplex ? "Passing input through" : "Playing sawtooth waves") << ", buffer size "
+              << bufferFrames << ", " << stream->writeAvailable() << " frames of ring" << std::endl;
+
+    // Two periods of silence keep the output going while the first input period is recorded.
+    std::vector<MY_TYPE> buffer(bufferFrames * channels, 0);
+    stream->write(buffer.data(), bufferFrames);
+    stream->write(buffer.data(), bufferFrames);
+    if (stream->start() != RTAUDIO_NO_ERROR)
+        return 1;
+
+    std::vector<MY_TYPE> phase(channels, 0);
+    unsigned long long frames = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(durationMs)) {
+        if (duplex) {
+            if (stream->read(buffer.data(), bufferFrames) != bufferFrames)
+                break;
+        } else {
+            for (unsigned int i = 0; i < bufferFrames; i++) {
+                for (unsigned int c = 0; c < channels; c++) {
+                    buffer[i * channels + c] = phase[c];
+                    phase[c] += 0.005f * (c + 1);
+                    if (phase[c] >= 1.0f)
+                        phase[c] -= 2.0f;
+                }
+            }
+        }
+        if (stream->write(buffer.data(), bufferFrames) != bufferFrames)
+            break;
+        frames += bufferFrames;
+    }
+    stream->stop();
+
+    std::cout << "Wrote " << frames << " frames, " << stream->getOutputUnderflows() << " output underflows, "
+              << stream->getInputOverflows() << " input overflows" << std::endl;
+    return 0;
+}
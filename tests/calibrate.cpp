@@ -0,0 +1,128 @@
+/******************************************/
+/*
+  calibrate.cpp
+
+  Finds the smallest buffer size and period
+  count a device runs without xruns under a
+  synthetic callback load.
+*/
+/******************************************/
+
+#include "LatencyCalibrator.h"
+#include "RtAudio.h"
+#include "cliutils.h"
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+void usage(const CLIParams& params) {
+    std::cout << "\nuseage: calibrate " << params.getShortString() << "\n";
+    std::cout << params.getFullString();
+}
+
+std::vector<unsigned int> parseList(const std::string& text) {
+    std::vector<unsigned int> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        unsigned int value = (unsigned int)atoi(item.c_str());
+        if (value > 0)
+            values.push_back(value);
+    }
+    return values;
+}
+
+RtApi::StreamMode getModeFromString(const std::string& mode) {
+    if (mode == "input")
+        return RtApi::INPUT;
+    if (mode == "duplex")
+        return RtApi::DUPLEX;
+    if (mode == "output")
+        return RtApi::OUTPUT;
+    return RtApi::UNINITIALIZED;
+}
+
+void printCandidate(const LatencyCalibrator::Candidate& c, unsigned int sampleRate) {
+    std::cout << "buffer " << c.bufferSize;
+    if (c.opened == false) {
+        std::cout << " x " << c.periods << ": failed to open" << std::endl;
+        return;
+    }
+    if (c.actualBufferSize != c.bufferSize)
+        std::cout << " (" << c.actualBufferSize << ")";
+    std::cout << " x " << c.periods
+              << ", " << c.latencyFrames() * 1000.0 / sampleRate << " ms"
+              << ", callbacks " << c.callbacks
+              << ", xruns " << c.xruns
+              << ", late " << c.deadlineMisses
+              << ", max load " << int(c.maxLoad * 100) << "%"
+              << (c.isStable() ? "  stable" : "") << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    CLIParams params({
+        {"api", "name of audio API", false},
+        {"device", "device busID to use", false},
+        {"mode", "output, input or duplex", true, "output"},
+        {"load", "callback load in percent of a period", true, "50"},
+        {"time", "time per candidate in milliseconds", true, "5000"},
+        {"channels", "number of channels", true, "2"},
+        {"samplerate", "the sample rate", true, "48000"},
+        {"buffers", "comma separated buffer sizes", true, "32,64,128,256,512,1024"},
+        {"periods", "comma separated period counts", true, "2,3,4"},
+        {"margin", "periods added to the smallest stable configuration", true, "1"},
+        });
+
+    if (params.checkCountArgc(argc) == false) {
+        usage(params);
+        return 1;
+    }
+    auto api = RtAudio::getCompiledApiByName(params.getParamValue("api", argv, argc));
+    if (api == RtAudio::UNSPECIFIED) {
+        std::cout << "\nNo api found!\n";
+        return 1;
+    }
+    std::cout << "Using API: " << RtAudio::getApiDisplayName(api) << std::endl;
+
+    LatencyCalibrator::Params calibration;
+    calibration.api = api;
+    calibration.busId = params.getParamValue("device", argv, argc);
+    calibration.mode = getModeFromString(params.getParamValue("mode", argv, argc));
+    if (calibration.mode == RtApi::UNINITIALIZED) {
+        std::cout << "\nMode is not valid!\n";
+        return 1;
+    }
+    calibration.dspLoad = atoi(params.getParamValue("load", argv, argc)) / 100.0;
+    calibration.durationMs = atoi(params.getParamValue("time", argv, argc));
+    calibration.channels = atoi(params.getParamValue("channels", argv, argc));
+    calibration.sampleRate = atoi(params.getParamValue("samplerate", argv, argc));
+    calibration.bufferSizes = parseList(params.getParamValue("buffers", argv, argc));
+    calibration.periodCounts = parseList(params.getParamValue("periods", argv, argc));
+    calibration.safetyPeriods = atoi(params.getParamValue("margin", argv, argc));
+    calibration.flags = RTAUDIO_SCHEDULE_REALTIME;
+    calibration.priority = INT_MAX;
+    if (calibration.bufferSizes.empty() || calibration.periodCounts.empty()) {
+        std::cout << "\nNo candidates to try!\n";
+        return 1;
+    }
+
+    LatencyCalibrator calibrator(calibration);
+    calibrator.setProgressCallback([&](const LatencyCalibrator::Candidate& c) {
+        printCandidate(c, calibration.sampleRate);
+    });
+    auto result = calibrator.run();
+    std::cout << std::endl;
+    if (!result.smallestStable) {
+        std::cout << "No stable configuration found" << std::endl;
+        return 1;
+    }
+    std::cout << "Smallest stable: buffer " << result.smallestStable->actualBufferSize
+              << " x " << result.smallestStable->periods << std::endl;
+    std::cout << "Recommended:     buffer " << result.recommendedBufferSize
+              << " x " << result.recommendedPeriods << ", "
+              << result.recommendedBufferSize * result.recommendedPeriods * 1000.0 / calibration.sampleRate
+              << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,266 @@
+/******************************************/
+/*
+  callbackjitter.cpp
+
+  Measures how regularly the stream callback
+  is invoked: the distribution of intervals
+  between callbacks and how late each one is
+  against the ideal period, optionally with
+  CPU and memory stress threads running.
+*/
+/******************************************/
+
+#include "RtAudio.h"
+#include "cliutils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+#if !defined(_WIN32)
+#include <time.h>
+#endif
+
+void usage(const CLIParams& params) {
+    std::cout << "\nuseage: callbackjitter " << params.getShortString() << "\n";
+    std::cout << params.getFullString();
+}
+
+void errorCallback(RtAudioErrorType /*type*/, const std::string& errorText)
+{
+    std::cerr << "\nerrorCallback: " << errorText << "\n\n";
+}
+
+int64_t monotonicNowNs() {
+#if defined(_WIN32)
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+RtApi::StreamMode getModeFromString(const std::string& mode) {
+    if (mode == "input")
+        return RtApi::INPUT;
+    if (mode == "output")
+        return RtApi::OUTPUT;
+    return RtApi::UNINITIALIZED;
+}
+
+struct UserData {
+    // Preallocated, the callback only stores into it.
+    std::vector<int64_t> timestamps;
+    std::vector<unsigned int> frames;
+    std::atomic<size_t> count = 0;
+    unsigned long xruns = 0;
+};
+
+int timingCallback(void * /*outputBuffer*/,
+                   const void * /*inputBuffer*/,
+                   unsigned int nBufferFrames,
+                   double /*streamTime*/,
+                   RtAudioStreamStatus status,
+                   void *data)
+{
+    int64_t now = monotonicNowNs();
+    UserData *userData = static_cast<UserData *>(data);
+    size_t index = userData->count.load(std::memory_order_relaxed);
+    if (status)
+        userData->xruns++;
+    if (index < userData->timestamps.size()) {
+        userData->timestamps[index] = now;
+        userData->frames[index] = nBufferFrames;
+        userData->count.store(index + 1, std::memory_order_release);
+    }
+    return 0;
+}
+
+void cpuStress(const std::atomic_bool& stop) {
+    volatile double x = 1.0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        for (int i = 0; i < 100000; i++)
+            x = x * 1.0000001 + 0.0000001;
+    }
+}
+
+void memoryStress(const std::atomic_bool& stop, size_t bytes) {
+    // Two buffers larger than the last level cache keep evicting the
+    // audio thread's working set and load the memory bus.
+    std::vector<char> a(bytes, 1), b(bytes, 2);
+    while (!stop.load(std::memory_order_relaxed)) {
+        std::memcpy(b.data(), a.data(), bytes);
+        std::swap(a, b);
+    }
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    size_t index = size_t(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+void printDistribution(const char* name, std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(3)
+              << " min " << std::setw(9) << (values.empty() ? 0 : values.front())
+              << "  p50 " << std::setw(9) << percentile(values, 50)
+              << "  p99 " << std::setw(9) << percentile(values, 99)
+              << "  p99.9 " << std::setw(9) << percentile(values, 99.9)
+              << "  max " << std::setw(9) << (values.empty() ? 0 : values.back())
+              << " ms" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    CLIParams params({
+        {"api", "name of audio API", false},
+        {"device", "device busID to use", false},
+        {"mode", "output or input", true, "output"},
+        {"time", "measurement time in seconds", true, "30"},
+        {"channels", "number of channels", true, "2"},
+        {"samplerate", "the sample rate", true, "48000"},
+        {"buffer", "buffer frames", true, "256"},
+        {"cpustress", "number of busy loop threads", true, "0"},
+        {"memstress", "number of memory copy threads", true, "0"},
+        {"memsize", "memory copied per stress thread in MiB", true, "64"},
+        });
+
+    if (params.checkCountArgc(argc) == false) {
+        usage(params);
+        return 1;
+    }
+    auto api = RtAudio::getCompiledApiByName(params.getParamValue("api", argv, argc));
+    if (api == RtAudio::UNSPECIFIED) {
+        std::cout << "\nNo api found!\n";
+        return 1;
+    }
+    std::cout << "Using API: " << RtAudio::getApiDisplayName(api) << std::endl;
+
+    RtApi::StreamMode mode = getModeFromString(params.getParamValue("mode", argv, argc));
+    if (mode == RtApi::UNINITIALIZED) {
+        std::cout << "\nMode is not valid!\n";
+        return 1;
+    }
+    unsigned int seconds = atoi(params.getParamValue("time", argv, argc));
+    unsigned int channels = atoi(params.getParamValue("channels", argv, argc));
+    unsigned int fs = atoi(params.getParamValue("samplerate", argv, argc));
+    unsigned int bufferFrames = atoi(params.getParamValue("buffer", argv, argc));
+    unsigned int cpuThreads = atoi(params.getParamValue("cpustress", argv, argc));
+    unsigned int memThreads = atoi(params.getParamValue("memstress", argv, argc));
+    size_t memBytes = size_t(atoi(params.getParamValue("memsize", argv, argc))) * 1024 * 1024;
+    if (bufferFrames == 0 || fs == 0) {
+        std::cout << "\nBuffer size and sample rate must not be zero!\n";
+        return 1;
+    }
+
+    auto factory = RtAudio::GetRtAudioStreamFactory(api);
+    if (!factory) {
+        std::cout << "\nNo factory available!\n";
+        return 1;
+    }
+    factory->setErrorCallback(errorCallback);
+
+    UserData userData;
+    RtAudio::StreamOptions options{};
+    options.flags |= RTAUDIO_SCHEDULE_REALTIME;
+    options.priority = INT_MAX;
+
+    CreateStreamParams streamParams{};
+    streamParams.busId = params.getParamValue("device", argv, argc);
+    streamParams.mode = mode;
+    if (mode == RtApi::INPUT)
+        streamParams.channelsInput = channels;
+    else
+        streamParams.channelsOutput = channels;
+    streamParams.sampleRate = fs;
+    streamParams.format = RTAUDIO_FLOAT32;
+    streamParams.bufferSize = bufferFrames;
+    streamParams.callback = timingCallback;
+    streamParams.userData = &userData;
+    streamParams.options = &options;
+
+    auto stream = factory->createStream(streamParams);
+    if (!stream) {
+        std::cout << "\nFailed to create stream!\n";
+        return 1;
+    }
+    stream->setErrorCallback(errorCallback);
+    bufferFrames = stream->getBufferSize();
+    double idealPeriodMs = bufferFrames * 1000.0 / fs;
+    std::cout << "Stream created! Buffer size: " << bufferFrames
+              << ", ideal period " << idealPeriodMs << " ms" << std::endl;
+
+    // Twice the expected count leaves room for short callbacks.
+    size_t expected = size_t(double(seconds) * fs / bufferFrames) + 1;
+    userData.timestamps.assign(expected * 2, 0);
+    userData.frames.assign(expected * 2, 0);
+
+    std::atomic_bool stopStress = false;
+    std::vector<std::thread> stressThreads;
+    for (unsigned int i = 0; i < cpuThreads; i++)
+        stressThreads.emplace_back(cpuStress, std::cref(stopStress));
+    for (unsigned int i = 0; i < memThreads; i++)
+        stressThreads.emplace_back(memoryStress, std::cref(stopStress), memBytes);
+    if (!stressThreads.empty())
+        std::cout << "Running " << cpuThreads << " cpu and " << memThreads << " memory stress threads" << std::endl;
+
+    bool failed = stream->startStream() != RTAUDIO_NO_ERROR;
+    if (!failed) {
+        int64_t end = monotonicNowNs() + int64_t(seconds) * 1000000000;
+        while (stream->isStreamRunning() && monotonicNowNs() < end &&
+               userData.count.load(std::memory_order_acquire) < userData.timestamps.size())
+            SLEEP(100);
+        failed = stream->isStreamRunning() == false;
+        stream->stopStream();
+    }
+    stopStress = true;
+    for (auto& t : stressThreads)
+        t.join();
+    if (failed) {
+        std::cout << "\nError while running stream!\n";
+        return 1;
+    }
+
+    size_t count = userData.count.load(std::memory_order_acquire);
+    if (count < 3) {
+        std::cout << "\nNot enough callbacks recorded!\n";
+        return 1;
+    }
+
+    // The first callbacks fill the device buffer back to back, skip them.
+    size_t first = std::min<size_t>(count / 10, 2 * (fs / bufferFrames / 10 + 1));
+    std::vector<double> intervals;
+    std::vector<double> lateness;
+    int64_t origin = userData.timestamps[first];
+    double idealNs = 0;
+    for (size_t i = first + 1; i < count; i++) {
+        intervals.push_back((userData.timestamps[i] - userData.timestamps[i - 1]) / 1e6);
+        // Ideal time of a callback follows from the frames delivered before it.
+        idealNs += userData.frames[i - 1] * 1e9 / fs;
+        lateness.push_back((userData.timestamps[i] - origin - idealNs) / 1e6);
+    }
+    // Lateness is relative to the earliest callback, clock drift between
+    // the device and CLOCK_MONOTONIC shows up as a slow trend.
+    double earliest = *std::min_element(lateness.begin(), lateness.end());
+    for (auto& l : lateness)
+        l -= earliest;
+
+    std::cout << std::endl << "Callbacks: " << count - first << ", xruns: " << userData.xruns << std::endl;
+    printDistribution("interval", intervals);
+    printDistribution("lateness", lateness);
+    unsigned long overPeriod = std::count_if(lateness.begin(), lateness.end(),
+                                             [&](double l) { return l > idealPeriodMs; });
+    std::cout << "Callbacks later than one period: " << overPeriod << std::endl;
+    return 0;
+}
@@ -0,0 +1,137 @@
+/******************************************/
+/*
+  offlinerender.cpp
+
+  Renders a stream faster than real time into
+  a WAV file: sawtooth waves, or the input file
+  passed through with a gain when one is given.
+*/
+/******************************************/
+
+#include "OfflineRender.h"
+#include "RtAudio.h"
+#include "cliutils.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+typedef float MY_TYPE;
+#define FORMAT RTAUDIO_FLOAT32
+
+void usage(const CLIParams& params) {
+    std::cout << "\nuseage: offlinerender " << params.getShortString() << "\n";
+    std::cout << params.getFullString();
+}
+
+void errorCallback(RtAudioErrorType /*type*/, const std::string& errorText)
+{
+    std::cerr << "\nerrorCallback: " << errorText << "\n\n";
+}
+
+struct UserData {
+    unsigned int channels = 0;
+    MY_TYPE gain = 1;
+    std::vector<MY_TYPE> phase;
+};
+
+int renderSaw(void *outputBuffer,
+              const void * /*inputBuffer*/,
+              unsigned int nBufferFrames,
+              double /*streamTime*/,
+              RtAudioStreamStatus /*status*/,
+              void *data)
+{
+    UserData *userData = static_cast<UserData *>(data);
+    MY_TYPE *out = static_cast<MY_TYPE *>(outputBuffer);
+    for (unsigned int i = 0; i < nBufferFrames; i++) {
+        for (unsigned int c = 0; c < userData->channels; c++) {
+            *out++ = userData->phase[c];
+            userData->phase[c] += 0.005f * (c + 1);
+            if (userData->phase[c] >= 1.0f)
+                userData->phase[c] -= 2.0f;
+        }
+    }
+    return 0;
+}
+
+int renderGain(void *outputBuffer,
+               const void *inputBuffer,
+               unsigned int nBufferFrames,
+               double /*streamTime*/,
+               RtAudioStreamStatus /*status*/,
+               void *data)
+{
+    UserData *userData = static_cast<UserData *>(data);
+    MY_TYPE *out = static_cast<MY_TYPE *>(outputBuffer);
+    const MY_TYPE *in = static_cast<const MY_TYPE *>(inputBuffer);
+    for (unsigned int i = 0; i < nBufferFrames * userData->channels; i++)
+        out[i] = in[i] * userData->gain;
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    CLIParams params({
+        {"output", "WAV file to write", false},
+        {"seconds", "length to render, 0 for the whole input file", true, "60"},
+        {"channels", "number of channels", true, "2"},
+        {"samplerate", "the sample rate", true, "48000"},
+        {"input", "WAV file passed through to the output", true, ""},
+        {"gain", "gain applied to the input file", true, "0.5"},
+        });
+
+    if (params.checkCountArgc(argc) == false) {
+        usage(params);
+        return 1;
+    }
+
+    OfflineRenderConfig config;
+    config.outputFile = params.getParamValue("output", argv, argc);
+    config.inputFile = params.getParamValue("input", argv, argc);
+    unsigned int fs = atoi(params.getParamValue("samplerate", argv, argc));
+    config.lengthFrames = (unsigned long long)atof(params.getParamValue("seconds", argv, argc)) * fs;
+
+    UserData userData;
+    userData.channels = atoi(params.getParamValue("channels", argv, argc));
+    userData.gain = (MY_TYPE)atof(params.getParamValue("gain", argv, argc));
+    userData.phase.assign(userData.channels, 0);
+    if (config.inputFile.empty() && config.lengthFrames == 0) {
+        std::cout << "\nLength required without input file!\n";
+        return 1;
+    }
+
+    RtApiOfflineStreamFactory factory(config);
+    factory.setErrorCallback(errorCallback);
+
+    CreateStreamParams streamParams{};
+    streamParams.mode = config.inputFile.empty() ? RtApi::OUTPUT : RtApi::DUPLEX;
+    streamParams.channelsOutput = userData.channels;
+    streamParams.channelsInput = config.inputFile.empty() ? 0 : userData.channels;
+    streamParams.sampleRate = fs;
+    streamParams.format = FORMAT;
+    streamParams.bufferSize = 512;
+    streamParams.callback = config.inputFile.empty() ? renderSaw : renderGain;
+    streamParams.userData = &userData;
+
+    RtAudio::StreamOptions options{};
+    streamParams.options = &options;
+
+    auto stream = factory.createOfflineStream(streamParams);
+    if (!stream) {
+        std::cout << "\nFailed to create stream!\n";
+        return 1;
+    }
+    stream->setErrorCallback(errorCallback);
+
+    auto start = std::chrono::steady_clock::now();
+    RtAudioErrorType result = stream->render();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (result != RTAUDIO_NO_ERROR)
+        return 1;
+
+    double seconds = double(stream->getRenderedFrames()) / fs;
+    std::cout << "Rendered " << stream->getRenderedFrames() << " frames (" << seconds << " s) in "
+              << elapsed << " s, " << (elapsed > 0 ? seconds / elapsed : 0) << "x real time" << std::endl;
+    std::cout << "Stream time: " << stream->getStreamTime() << " s" << std::endl;
+    return 0;
+}
@@ -3,7 +3,7 @@
 #include <cstdlib>
 #include <chrono>
 #include "cliutils.h"
-#include "ringbuf.hpp"
+#include "AudioRingBuffer.h"
 #include <thread>
 #include <atomic>
 
@@ -24,11 +24,10 @@ void usage(const CLIParams& params) {
 }
 
 struct UserData {
-    RingBuffer<MY_TYPE> ringbuffer;
+    AudioRingBuffer<MY_TYPE> ringbuffer;
     unsigned int channels = 0;
-    unsigned int ringbufferFill = 0;
-    std::mutex mut;
-    bool filled = false;
+    unsigned int ringbufferFill = 0; // In frames.
+    bool filled = false; // Playback callback only.
 };
 
 int playbackAudioCallback(void *outputBuffer,
@@ -39,21 +38,18 @@ int playbackAudioCallback(void *outputBuffer,
                           void *data)
 {
     UserData* userData = static_cast<UserData*>(data);
-    std::lock_guard<std::mutex> g(userData->mut);
     if (userData->filled == false) {
-        if (userData->ringbuffer.ReadAvailable(userData->ringbufferFill) == false) {
+        if (userData->ringbuffer.readAvailable() < userData->ringbufferFill) {
             memset(outputBuffer, 0, sizeof(MY_TYPE) * nBufferFrames * userData->channels);
             return 0;
         }
         userData->filled = true;
     }
 
-    if (userData->ringbuffer.ReadAvailable(nBufferFrames * userData->channels) == false) {
+    if (userData->ringbuffer.read(reinterpret_cast<MY_TYPE*>(outputBuffer), nBufferFrames) == false) {
+        memset(outputBuffer, 0, sizeof(MY_TYPE) * nBufferFrames * userData->channels);
         userData->filled = false;
-        return 0;
     }
-
-    userData->ringbuffer.Read(reinterpret_cast<MY_TYPE*>(outputBuffer), nBufferFrames * userData->channels);
     return 0;
 }
 
@@ -65,11 +61,7 @@ int captureAudioCallback(void *outputBuffer,
                          void *data)
 {
     UserData *userData = static_cast<UserData *>(data);
-    std::lock_guard<std::mutex> g(userData->mut);
-    if (!userData->ringbuffer.WriteAvailable(nBufferFrames * userData->channels)) {
-        return 0;
-    }
-    userData->ringbuffer.Write(reinterpret_cast<const MY_TYPE*>(inputBuffer), nBufferFrames * userData->channels);
+    userData->ringbuffer.write(reinterpret_cast<const MY_TYPE*>(inputBuffer), nBufferFrames);
     return 0;
 }
 
@@ -296,9 +288,10 @@ int main(int argc, char* argv[]) {
     print_device(*selectedDeviceOut);
 
     UserData userData;
-    userData.ringbuffer = RingBuffer<MY_TYPE>(ringbufferFill * 2);
+    // The fill level is given in samples.
+    userData.ringbuffer.resize(ringbufferFill / channels * 2, channels);
     userData.channels = channels;
-    userData.ringbufferFill = ringbufferFill;
+    userData.ringbufferFill = ringbufferFill / channels;
 
     AudioParamsCapture paramsPass;
     paramsPass.api = api;
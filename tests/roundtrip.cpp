@@ -0,0 +1,231 @@
+/******************************************/
+/*
+  roundtrip.cpp
+
+  Measures the input-to-output latency of a
+  duplex stream. A maximum-length sequence is
+  played on all output channels and captured
+  on a looped back input (cable or ALSA aloop),
+  the delay is found by cross-correlation.
+*/
+/******************************************/
+
+#include "RtAudio.h"
+#include "cliutils.h"
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+typedef float MY_TYPE;
+#define FORMAT RTAUDIO_FLOAT32
+
+void usage(const CLIParams& params) {
+    std::cout << "\nuseage: roundtrip " << params.getShortString() << "\n";
+    std::cout << params.getFullString();
+}
+
+void errorCallback(RtAudioErrorType /*type*/, const std::string& errorText)
+{
+    std::cerr << "\nerrorCallback: " << errorText << "\n\n";
+}
+
+// Bipolar maximum-length sequence from a Galois LFSR. Its circular
+// autocorrelation is a single peak, which makes the delay unambiguous.
+std::vector<MY_TYPE> makeMls(unsigned int order, MY_TYPE amplitude) {
+    static const unsigned int taps[] = {0, 0, 0x3, 0x6, 0xC, 0x14, 0x30, 0x60, 0xB8, 0x110, 0x240,
+                                        0x500, 0xE08, 0x1C80, 0x3802, 0x6000, 0xD008, 0x12000};
+    unsigned int length = (1u << order) - 1;
+    std::vector<MY_TYPE> sequence(length);
+    unsigned int state = 1;
+    for (unsigned int i = 0; i < length; i++) {
+        bool bit = state & 1;
+        sequence[i] = bit ? amplitude : -amplitude;
+        state >>= 1;
+        if (bit)
+            state ^= taps[order];
+    }
+    return sequence;
+}
+
+struct UserData {
+    std::vector<MY_TYPE> sequence;
+    std::vector<MY_TYPE> captured;
+    unsigned int outputChannels = 0;
+    unsigned int inputChannels = 0;
+    unsigned int inputChannel = 0;
+    unsigned long leadIn = 0;
+    unsigned long frame = 0;
+    std::atomic_bool done = false;
+};
+
+int duplexCallback(void *outputBuffer,
+                   const void *inputBuffer,
+                   unsigned int nBufferFrames,
+                   double /*streamTime*/,
+                   RtAudioStreamStatus status,
+                   void *data)
+{
+    UserData *userData = static_cast<UserData *>(data);
+    MY_TYPE *out = static_cast<MY_TYPE *>(outputBuffer);
+    const MY_TYPE *in = static_cast<const MY_TYPE *>(inputBuffer);
+    for (unsigned int i = 0; i < nBufferFrames; i++) {
+        unsigned long frame = userData->frame + i;
+        MY_TYPE value = 0;
+        if (frame >= userData->leadIn && frame - userData->leadIn < userData->sequence.size())
+            value = userData->sequence[frame - userData->leadIn];
+        for (unsigned int c = 0; c < userData->outputChannels; c++)
+            out[i * userData->outputChannels + c] = value;
+        if (frame < userData->captured.size())
+            userData->captured[frame] = in[i * userData->inputChannels + userData->inputChannel];
+    }
+    userData->frame += nBufferFrames;
+    if (userData->frame >= userData->captured.size())
+        userData->done = true;
+    return 0;
+}
+
+struct Peak {
+    long lag = -1;
+    double value = 0;
+    double ratio = 0; // Against the largest correlation outside the peak.
+};
+
+Peak findDelay(const std::vector<MY_TYPE>& sequence, const std::vector<MY_TYPE>& captured, unsigned long leadIn) {
+    Peak peak;
+    std::vector<double> correlation;
+    for (unsigned long lag = 0; leadIn + lag + sequence.size() <= captured.size(); lag++) {
+        double sum = 0;
+        const MY_TYPE *x = captured.data() + leadIn + lag;
+        for (size_t i = 0; i < sequence.size(); i++)
+            sum += double(x[i]) * sequence[i];
+        correlation.push_back(sum);
+        if (std::fabs(sum) > std::fabs(peak.value)) {
+            peak.value = sum;
+            peak.lag = lag;
+        }
+    }
+    double second = 0;
+    for (size_t lag = 0; lag < correlation.size(); lag++) {
+        if (std::labs(long(lag) - peak.lag) > 2)
+            second = std::max(second, std::fabs(correlation[lag]));
+    }
+    peak.ratio = second > 0 ? std::fabs(peak.value) / second : 0;
+    return peak;
+}
+
+int main(int argc, char* argv[])
+{
+    CLIParams params({
+        {"api", "name of audio API", false},
+        {"device", "device busID to use", false},
+        {"samplerate", "the sample rate", true, "48000"},
+        {"buffer", "buffer frames", true, "256"},
+        {"ochannels", "number of output channels", true, "2"},
+        {"ichannels", "number of input channels", true, "2"},
+        {"ichannel", "input channel carrying the loopback", true, "0"},
+        {"order", "MLS order, the sequence is 2^order - 1 frames", true, "14"},
+        {"maxdelay", "longest delay searched in milliseconds", true, "1000"},
+        });
+
+    if (params.checkCountArgc(argc) == false) {
+        usage(params);
+        return 1;
+    }
+    auto api = RtAudio::getCompiledApiByName(params.getParamValue("api", argv, argc));
+    if (api == RtAudio::UNSPECIFIED) {
+        std::cout << "\nNo api found!\n";
+        return 1;
+    }
+    std::cout << "Using API: " << RtAudio::getApiDisplayName(api) << std::endl;
+
+    unsigned int fs = atoi(params.getParamValue("samplerate", argv, argc));
+    unsigned int bufferFrames = atoi(params.getParamValue("buffer", argv, argc));
+    unsigned int order = atoi(params.getParamValue("order", argv, argc));
+    unsigned int maxDelayMs = atoi(params.getParamValue("maxdelay", argv, argc));
+    if (order < 4 || order > 17) {
+        std::cout << "\nMLS order must be between 4 and 17!\n";
+        return 1;
+    }
+
+    UserData userData;
+    userData.outputChannels = atoi(params.getParamValue("ochannels", argv, argc));
+    userData.inputChannels = atoi(params.getParamValue("ichannels", argv, argc));
+    userData.inputChannel = atoi(params.getParamValue("ichannel", argv, argc));
+    if (userData.inputChannel >= userData.inputChannels) {
+        std::cout << "\nInput channel out of range!\n";
+        return 1;
+    }
+    userData.sequence = makeMls(order, 0.5f);
+    // Let the stream settle before the sequence starts.
+    userData.leadIn = fs / 2;
+    userData.captured.assign(userData.leadIn + userData.sequence.size() + (unsigned long)fs * maxDelayMs / 1000, 0);
+
+    auto factory = RtAudio::GetRtAudioStreamFactory(api);
+    if (!factory) {
+        std::cout << "\nNo factory available!\n";
+        return 1;
+    }
+    factory->setErrorCallback(errorCallback);
+
+    RtAudio::StreamOptions options{};
+    options.flags |= RTAUDIO_SCHEDULE_REALTIME;
+    options.priority = INT_MAX;
+
+    CreateStreamParams streamParams{};
+    streamParams.busId = params.getParamValue("device", argv, argc);
+    streamParams.mode = RtApi::DUPLEX;
+    streamParams.channelsInput = userData.inputChannels;
+    streamParams.channelsOutput = userData.outputChannels;
+    streamParams.sampleRate = fs;
+    streamParams.format = FORMAT;
+    streamParams.bufferSize = bufferFrames;
+    streamParams.callback = duplexCallback;
+    streamParams.userData = &userData;
+    streamParams.options = &options;
+
+    auto stream = factory->createStream(streamParams);
+    if (!stream) {
+        std::cout << "\nFailed to create duplex stream!\n";
+        return 1;
+    }
+    stream->setErrorCallback(errorCallback);
+    std::cout << "Stream created! Buffer size: " << stream->getBufferSize() << std::endl;
+    if (stream->startStream() != RTAUDIO_NO_ERROR) {
+        std::cout << "\nStream start error\n";
+        return 1;
+    }
+    while (stream->isStreamRunning() && userData.done == false)
+        SLEEP(50);
+    long reportedLatency = stream->getStreamLatency();
+    bool failed = stream->isStreamRunning() == false;
+    stream->stopStream();
+    if (failed) {
+        std::cout << "\nError while running stream!\n";
+        return 1;
+    }
+
+    auto xruns = stream->getXrunStatistics();
+    if (xruns.outputUnderflows || xruns.inputOverflows)
+        std::cout << "Warning: " << xruns.outputUnderflows << " underflows and "
+                  << xruns.inputOverflows << " overflows during the measurement" << std::endl;
+
+    Peak peak = findDelay(userData.sequence, userData.captured, userData.leadIn);
+    if (peak.lag < 0 || peak.ratio < 4) {
+        std::cout << "\nNo clear correlation peak found, check the loopback connection"
+                  << " (peak ratio " << peak.ratio << ")." << std::endl;
+        return 1;
+    }
+    std::cout << std::endl;
+    std::cout << "Measured round trip: " << peak.lag << " frames, "
+              << peak.lag * 1000.0 / fs << " ms"
+              << (peak.value < 0 ? " (inverted polarity)" : "") << std::endl;
+    std::cout << "Reported latency:    " << reportedLatency << " frames, "
+              << reportedLatency * 1000.0 / fs << " ms" << std::endl;
+    std::cout << "Difference:          " << peak.lag - reportedLatency << " frames" << std::endl;
+    std::cout << "Peak ratio:          " << peak.ratio << std::endl;
+    return 0;
+}